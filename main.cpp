@@ -1,6 +1,497 @@
 #include <iostream>
 #include <chrono>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <algorithm>
+#include <memory>
+#include <filesystem>
+#include <sys/wait.h>
+#include <unistd.h>
 #include "SceneLoader.hpp"
+#include "PartialRender.hpp"
+#include "RenderCache.hpp"
+#include "SequenceRenderer.hpp"
+#include "SceneDiff.hpp"
+#include "../rayserver/RenderDaemon.hpp"
+#include "../raythread/CpuLimits.hpp"
+#include "../raythread/ThreadPool.hpp"
+
+using json = nlohmann::json;
+
+/**
+ * Command line: raytracer <scene.json> [output.png] [options]
+ *           or: raytracer merge <output.png> <part>...
+ *           or: raytracer --daemon <socket>
+ * The options are written into `render`, and override the "render" section of the scene file.
+ */
+struct CommandLine
+{
+  std::vector<std::string> positional;
+  json render = json::object();
+  // Draw the rendered region into the existing output image
+  bool inPlace = false;
+  // Write the rendered tiles to this partial file instead of a PNG
+  std::string partial;
+  // Number of forked worker processes
+  int processes = 1;
+  // Serve render requests on this Unix socket
+  std::string daemonSocket;
+  // Directory of the cache of finished images ("" = no cache), and its size limit
+  std::string cacheDirectory;
+  double cacheMegabytes = 512;
+  // Frames of the animation to render ("" = a single image), and how many at once
+  std::string frames;
+  int concurrentFrames = 1;
+  // Number of light edits of the relighting benchmark (0 = normal render)
+  int relightEdits = 0;
+  // Previous version of the scene: only the tiles its changes affect are rendered again
+  std::string updateFrom;
+};
+
+void printUsage()
+{
+  std::cerr << "Usage: raytracer <scene.json> [output.png] [options]" << std::endl;
+  std::cerr << "       raytracer merge <output.png> <part>...   assemble partial renders" << std::endl;
+  std::cerr << "       raytracer --daemon <socket>              serve render requests on a Unix socket" << std::endl;
+  std::cerr << "  --threads <n>             number of render threads (0 = automatic)" << std::endl;
+  std::cerr << "  --pin-threads             pin each render thread to its own core" << std::endl;
+  std::cerr << "  --tile-order <order>      scanline, morton or hilbert" << std::endl;
+  std::cerr << "  --integrator <name>       recursive or wavefront (same image)" << std::endl;
+  std::cerr << "  --sort-rays               wavefront: sort the reflected rays by origin and direction" << std::endl;
+  std::cerr << "  --antialiasing <mode>     none or adaptive" << std::endl;
+  std::cerr << "  --aa-max-samples <n>      maximum samples of a refined pixel" << std::endl;
+  std::cerr << "  --aa-threshold <t>        contrast above which a pixel is refined" << std::endl;
+  std::cerr << "  --time-budget <seconds>   progressive rendering, stopped at the deadline" << std::endl;
+  std::cerr << "  --region <x,y,w,h>        only render this rectangle of the frame (pixels)" << std::endl;
+  std::cerr << "  --crop                    output image of the size of the region" << std::endl;
+  std::cerr << "  --in-place                draw the region into the existing output image" << std::endl;
+  std::cerr << "  --tiles <begin-end[:step]> only render these tiles (row-major grid indices)" << std::endl;
+  std::cerr << "  --partial <file>          write the rendered tiles to a partial file" << std::endl;
+  std::cerr << "  --processes <n>           render with n forked worker processes" << std::endl;
+  std::cerr << "  --frames <begin-end|all> render frames of the animation (output: frame_%04d.png)" << std::endl;
+  std::cerr << "  --concurrent-frames <n>   frames rendered at once (0 = automatic)" << std::endl;
+  std::cerr << "  --update-from <old.json>  re-render the tiles changed since a previous version of the scene" << std::endl;
+  std::cerr << "  --relight-benchmark <n>   time n light edits relit from a G-buffer vs a full render" << std::endl;
+  std::cerr << "  --cache <directory>       reuse identical renders from an image cache" << std::endl;
+  std::cerr << "  --cache-size <MB>         size limit of the image cache (default 512)" << std::endl;
+  std::cerr << "  --checkpoint <file>       save the finished tiles to a checkpoint file" << std::endl;
+  std::cerr << "  --checkpoint-interval <s> seconds between two checkpoint writes" << std::endl;
+  std::cerr << "  --resume                  only render the tiles missing from the checkpoint" << std::endl;
+}
+
+CommandLine parseCommandLine(int argc, char *argv[])
+{
+  CommandLine cmd;
+  for (int i = 1; i < argc; ++i)
+  {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+
+    if (arg == "--threads" && hasValue)
+    {
+      cmd.render["threads"] = std::stoi(argv[++i]);
+    }
+    else if (arg == "--pin-threads")
+    {
+      cmd.render["pinThreads"] = true;
+    }
+    else if (arg == "--tile-order" && hasValue)
+    {
+      cmd.render["tileOrder"] = argv[++i];
+    }
+    else if (arg == "--integrator" && hasValue)
+    {
+      cmd.render["integrator"] = argv[++i];
+    }
+    else if (arg == "--sort-rays")
+    {
+      cmd.render["sortRays"] = true;
+    }
+    else if (arg == "--antialiasing" && hasValue)
+    {
+      cmd.render["antialiasing"]["mode"] = argv[++i];
+    }
+    else if (arg == "--aa-max-samples" && hasValue)
+    {
+      cmd.render["antialiasing"]["maxSamples"] = std::stoi(argv[++i]);
+    }
+    else if (arg == "--aa-threshold" && hasValue)
+    {
+      cmd.render["antialiasing"]["threshold"] = std::stod(argv[++i]);
+    }
+    else if (arg == "--time-budget" && hasValue)
+    {
+      cmd.render["timeBudget"] = std::stod(argv[++i]);
+    }
+    else if (arg == "--region" && hasValue)
+    {
+      int x, y, w, h;
+      if (std::sscanf(argv[++i], "%d,%d,%d,%d", &x, &y, &w, &h) != 4)
+      {
+        std::cerr << "[ERROR] --region expects x,y,width,height" << std::endl;
+        exit(1);
+      }
+      cmd.render["region"]["x"] = x;
+      cmd.render["region"]["y"] = y;
+      cmd.render["region"]["width"] = w;
+      cmd.render["region"]["height"] = h;
+    }
+    else if (arg == "--crop")
+    {
+      cmd.render["region"]["crop"] = true;
+    }
+    else if (arg == "--in-place")
+    {
+      cmd.inPlace = true;
+    }
+    else if (arg == "--tiles" && hasValue)
+    {
+      int begin, end, step = 1;
+      if (std::sscanf(argv[++i], "%d-%d:%d", &begin, &end, &step) < 2)
+      {
+        std::cerr << "[ERROR] --tiles expects begin-end or begin-end:step" << std::endl;
+        exit(1);
+      }
+      cmd.render["tiles"]["begin"] = begin;
+      cmd.render["tiles"]["end"] = end;
+      cmd.render["tiles"]["step"] = step;
+    }
+    else if (arg == "--partial" && hasValue)
+    {
+      cmd.partial = argv[++i];
+    }
+    else if (arg == "--processes" && hasValue)
+    {
+      cmd.processes = std::stoi(argv[++i]);
+    }
+    else if (arg == "--daemon" && hasValue)
+    {
+      cmd.daemonSocket = argv[++i];
+    }
+    else if (arg == "--frames" && hasValue)
+    {
+      cmd.frames = argv[++i];
+    }
+    else if (arg == "--concurrent-frames" && hasValue)
+    {
+      cmd.concurrentFrames = std::stoi(argv[++i]);
+    }
+    else if (arg == "--update-from" && hasValue)
+    {
+      cmd.updateFrom = argv[++i];
+      cmd.inPlace = true;
+    }
+    else if (arg == "--relight-benchmark" && hasValue)
+    {
+      cmd.relightEdits = std::stoi(argv[++i]);
+    }
+    else if (arg == "--cache" && hasValue)
+    {
+      cmd.cacheDirectory = argv[++i];
+    }
+    else if (arg == "--cache-size" && hasValue)
+    {
+      cmd.cacheMegabytes = std::stod(argv[++i]);
+    }
+    else if (arg == "--checkpoint" && hasValue)
+    {
+      cmd.render["checkpoint"] = argv[++i];
+    }
+    else if (arg == "--checkpoint-interval" && hasValue)
+    {
+      cmd.render["checkpointInterval"] = std::stod(argv[++i]);
+    }
+    else if (arg == "--resume")
+    {
+      cmd.render["resume"] = true;
+    }
+    else if (arg.rfind("--", 0) == 0)
+    {
+      std::cerr << "[ERROR] Unknown option: " << arg << std::endl;
+      printUsage();
+      exit(1);
+    }
+    else
+    {
+      cmd.positional.push_back(arg);
+    }
+  }
+  return cmd;
+}
+
+/**
+ * Writes the tiles rendered by this process (Settings.tiles) to a partial file.
+ */
+bool writePartial(std::string const &partPath, Scene *scene, Camera *camera, Image *image)
+{
+  RenderRegion region = camera->getRegion(*image);
+  std::string error;
+  if (!PartialRender::write(partPath, scene->contentHash, *image, region.crop ? 0 : region.x, region.crop ? 0 : region.y,
+                            region.width, region.height, std::max(camera->Settings.tileSize, 1),
+                            camera->Settings.tiles, error))
+  {
+    std::cerr << "[ERROR] " << error << std::endl;
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Local coordinator: forks `processes` workers. Worker k renders the tiles
+ * k, k + n, k + 2n... of the tiles to render (interleaved, so that each one
+ * gets its share of the expensive parts of the image) into a partial file,
+ * then the parts are merged into the image.
+ * Only the forking thread exists in a child: the shared pool is replaced there
+ * (see ThreadPool), no other thread may be running.
+ */
+bool renderWithProcesses(int processes, std::string const &outpath, Scene *scene, Camera *camera, Image *image)
+{
+  std::vector<pid_t> workers;
+  std::vector<std::string> parts;
+  // The CPUs are shared between the workers
+  int threads = camera->Settings.threads > 0 ? camera->Settings.threads : CpuLimits::detect().recommendedThreads();
+  threads = std::max(1, threads / processes);
+
+  for (int k = 0; k < processes; ++k)
+  {
+    std::string partPath = outpath + ".part" + std::to_string(k);
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+      std::freopen("/dev/null", "w", stdout);
+      camera->Settings.threads = threads;
+      // Interleaved within the requested tiles (--tiles, --update-from)
+      TileSubset &tiles = camera->Settings.tiles;
+      tiles.begin = std::max(tiles.begin, 0) + k * std::max(tiles.step, 1);
+      tiles.step = std::max(tiles.step, 1) * processes;
+      if (!camera->Settings.checkpoint.empty())
+      {
+        camera->Settings.checkpoint += "." + std::to_string(k);
+      }
+      try
+      {
+        camera->render(*image, *scene);
+      }
+      catch (std::exception const &e)
+      {
+        std::cerr << "[ERROR] " << e.what() << std::endl;
+        _exit(1);
+      }
+      std::fflush(stdout);
+      _exit(writePartial(partPath, scene, camera, image) ? 0 : 1);
+    }
+    if (pid < 0)
+    {
+      std::cerr << "[ERROR] cannot fork worker process " << k << std::endl;
+      break;
+    }
+    workers.push_back(pid);
+    parts.push_back(partPath);
+  }
+  std::cout << "Rendering with " << workers.size() << " processes of " << threads << " threads..." << std::endl;
+
+  bool ok = (int)workers.size() == processes;
+  for (size_t k = 0; k < workers.size(); ++k)
+  {
+    int status = 0;
+    waitpid(workers[k], &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+      std::cerr << "[ERROR] worker process " << k << " failed" << std::endl;
+      ok = false;
+    }
+  }
+
+  std::string error;
+  Image *merged = ok ? PartialRender::merge(parts, error, camera->Settings.tiles) : nullptr;
+  for (std::string const &part : parts)
+  {
+    std::remove(part.c_str());
+  }
+  if (merged == nullptr)
+  {
+    if (!error.empty())
+    {
+      std::cerr << "[ERROR] " << error << std::endl;
+    }
+    return false;
+  }
+
+  // Only the rendered tiles: the others keep the pixels of the image (--in-place, --update-from)
+  RenderRegion region = camera->getRegion(*image);
+  int x0 = region.crop ? 0 : region.x;
+  int y0 = region.crop ? 0 : region.y;
+  const int tileSize = std::max(camera->Settings.tileSize, 1);
+  const int tileCount = TileScheduler::gridTileCount(merged->width, merged->height, tileSize);
+  for (int i = 0; i < tileCount; ++i)
+  {
+    if (!camera->Settings.tiles.contains(i))
+    {
+      continue;
+    }
+    Tile tile = TileScheduler::gridTile(merged->width, merged->height, tileSize, i);
+    for (int y = tile.y0; y < tile.y1; ++y)
+    {
+      for (int x = tile.x0; x < tile.x1; ++x)
+      {
+        image->setPixel(x0 + x, y0 + y, merged->getPixel(x, y));
+      }
+    }
+  }
+  delete merged;
+  return true;
+}
+
+/**
+ * Sequence mode: renders the frames of the animation (--frames) in this process.
+ */
+int renderSequence(CommandLine const &cmd, json const &data, std::filesystem::path const &directory, std::string const &outpath)
+{
+  try
+  {
+    SequenceRenderer sequence(data, directory, cmd.concurrentFrames);
+    int first = 0;
+    int last = sequence.getFrameCount() - 1;
+    if (cmd.frames != "all" && std::sscanf(cmd.frames.c_str(), "%d-%d", &first, &last) != 2)
+    {
+      std::cerr << "[ERROR] --frames expects begin-end or all" << std::endl;
+      return 1;
+    }
+
+    std::cout << "Rendering frames " << first << " to " << last << ", " << sequence.getConcurrentFrames()
+              << " at once..." << std::endl;
+    auto begin = std::chrono::high_resolution_clock::now();
+    sequence.render(first, last, outpath);
+    std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - begin;
+
+    int frames = last - first + 1;
+    std::printf("Total time: %.3f seconds for %d frames (%.3f s per frame).\n", elapsed.count(), frames,
+                elapsed.count() / std::max(frames, 1));
+  }
+  catch (std::exception const &e)
+  {
+    std::cerr << "[ERROR] " << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * Incremental re-render: restricts the render to the tiles that the object
+ * changes since the previous version of the scene file can affect.
+ */
+void restrictToChangedTiles(std::string const &previousPath, json const &data, std::filesystem::path const &directory,
+                            Scene *scene, Camera *camera, Image *image)
+{
+  json previous = SceneLoader::Parse(previousPath);
+  std::filesystem::path previousDirectory = std::filesystem::path(previousPath).parent_path();
+  std::unique_ptr<Scene> previousScene(SceneLoader::LoadScene(previous, previousDirectory));
+
+  std::vector<bool> mask;
+  int changedObjects = 0;
+  std::string reason;
+  // Both scenes are prepared with the threads of the render
+  ThreadPool::configure(camera->Settings.threads, camera->Settings.pinThreads);
+  if (!SceneDiff::dirtyTiles(previous, previousDirectory, data, directory, *previousScene, *scene, *camera, *image,
+                             mask, changedObjects, reason))
+  {
+    std::cout << "Incremental: full render, " << reason << std::endl;
+    return;
+  }
+
+  long dirty = std::count(mask.begin(), mask.end(), true);
+  std::printf("Incremental: %d objects changed, %ld of %zu tiles to render (%.1f%%)\n", changedObjects, dirty,
+              mask.size(), 100.0 * dirty / std::max<size_t>(mask.size(), 1));
+  camera->Settings.tiles.mask = mask;
+}
+
+// Number of pixels of two images of the same size that differ
+long countDifferentPixels(Image &a, Image &b)
+{
+  long different = 0;
+  for (unsigned y = 0; y < a.height; ++y)
+  {
+    for (unsigned x = 0; x < a.width; ++x)
+    {
+      Color ca = a.getPixel(x, y);
+      Color cb = b.getPixel(x, y);
+      different += ca.r != cb.r || ca.g != cb.g || ca.b != cb.b;
+    }
+  }
+  return different;
+}
+
+/**
+ * Relighting benchmark: full render, then `edits` successive moves of the
+ * lights, each one re-shaded from the G-buffer, then a full render of the
+ * last lighting to check that relighting gives the same image.
+ */
+void relightBenchmark(int edits, Scene *scene, Camera *camera, Image *image)
+{
+  camera->render(*image, *scene);
+  double fullSeconds = camera->Stats.seconds;
+
+  GBuffer gbuffer;
+  Image relit(image->width, image->height);
+  camera->relight(relit, *scene, gbuffer);
+  double captureSeconds = camera->Stats.seconds;
+  long capturedDifferences = countDifferentPixels(relit, *image);
+
+  double total = 0;
+  double slowest = 0;
+  double fastest = 0;
+  for (int k = 1; k <= edits; ++k)
+  {
+    for (Light *light : scene->getLights())
+    {
+      light->SetPosition(light->GetPosition() + Vector3(0.25, 0.1, 0));
+    }
+    camera->relight(relit, *scene, gbuffer);
+    double seconds = camera->Stats.seconds;
+    total += seconds;
+    slowest = std::max(slowest, seconds);
+    fastest = k == 1 ? seconds : std::min(fastest, seconds);
+  }
+
+  camera->render(*image, *scene);
+  long differences = countDifferentPixels(relit, *image);
+
+  double average = total / std::max(edits, 1);
+  std::printf("Relighting benchmark (%d light edits):\n", edits);
+  std::printf("  Full render:      %.3f s\n", fullSeconds);
+  std::printf("  G-buffer capture: %.3f s (%ld pixels differ from the full render)\n", captureSeconds, capturedDifferences);
+  std::printf("  Relight:          %.3f s on average (%.3f to %.3f s), %.1fx faster than a full render\n",
+              average, fastest, slowest, fullSeconds / average);
+  std::printf("  Last edit:        %ld pixels differ from a full render of the same lighting\n", differences);
+}
+
+/**
+ * raytracer merge <output.png> <part>...
+ */
+int mergeCommand(CommandLine const &cmd)
+{
+  if (cmd.positional.size() < 3)
+  {
+    printUsage();
+    return 1;
+  }
+
+  std::vector<std::string> parts(cmd.positional.begin() + 2, cmd.positional.end());
+  std::string error;
+  Image *image = PartialRender::merge(parts, error);
+  if (image == nullptr)
+  {
+    std::cerr << "[ERROR] " << error << std::endl;
+    return 1;
+  }
+
+  std::string outpath = cmd.positional[1];
+  std::cout << "Merged " << parts.size() << " parts, writing file: " << outpath << std::endl;
+  image->writeFile(outpath);
+  delete image;
+  return 0;
+}
 
 int main(int argc, char *argv[])
 {
@@ -10,34 +501,159 @@ int main(int argc, char *argv[])
   std::cout << "*********************************" << std::endl;
   std::cout << std::endl;
 
-  if (argc < 2)
+  CommandLine cmd = parseCommandLine(argc, argv);
+
+  std::unique_ptr<RenderCache> cache;
+  if (!cmd.cacheDirectory.empty())
+  {
+    cache = std::make_unique<RenderCache>(cmd.cacheDirectory, (uint64_t)(cmd.cacheMegabytes * 1048576));
+  }
+
+  if (!cmd.daemonSocket.empty())
+  {
+    RenderDaemon daemon(cmd.daemonSocket, 8, cache.get());
+    return daemon.run() ? 0 : 1;
+  }
+
+  if (cmd.positional.empty())
   {
     std::cerr << "[ERROR] Please a path your scene file (.json)" << std::endl;
+    printUsage();
     std::cout << std::endl;
     exit(0);
   }
 
-  std::string path = argv[1];
-  auto [scene, camera, image] = SceneLoader::Load(path);
+  if (cmd.positional[0] == "merge")
+  {
+    return mergeCommand(cmd);
+  }
 
+  std::string path = cmd.positional[0];
   std::string outpath = "image.png";
-  if (argc > 2)
+  if (cmd.positional.size() > 1)
+  {
+    outpath = cmd.positional[1];
+  }
+
+  Scene *scene;
+  Camera *camera;
+  Image *image;
+  try
+  {
+    json data = SceneLoader::Parse(path);
+    if (!cmd.render.empty())
+    {
+      data["render"].merge_patch(cmd.render);
+    }
+    std::filesystem::path directory = std::filesystem::path(path).parent_path();
+
+    if (!cmd.frames.empty())
+    {
+      return renderSequence(cmd, data, directory, outpath);
+    }
+
+    // Only whole deterministic images are cached (not partial, tile subset, in place, relit or time-limited renders)
+    bool cacheable = cache && cmd.partial.empty() && !cmd.inPlace && cmd.relightEdits == 0 && SceneLoader::RendersAllTiles(data) &&
+                     (!data.contains("render") || data["render"].value("timeBudget", 0.0) <= 0);
+    if (cacheable && cache->fetch(SceneLoader::Hash(data, directory), outpath))
+    {
+      std::cout << "Identical render found in the cache, written to: " << outpath << std::endl;
+      cache->printStats(std::cout);
+      return 0;
+    }
+    if (!cacheable)
+    {
+      cache.reset();
+    }
+
+    std::tie(scene, camera, image) = SceneLoader::Load(data, directory);
+
+    if (!cmd.updateFrom.empty())
+    {
+      restrictToChangedTiles(cmd.updateFrom, data, directory, scene, camera, image);
+    }
+  }
+  catch (std::exception const &e)
+  {
+    std::cerr << "[ERROR] " << e.what() << std::endl;
+    exit(1);
+  }
+
+  if (cmd.inPlace)
   {
-    outpath = argv[2];
+    if (camera->Settings.region.crop || !image->readFile(outpath))
+    {
+      std::cerr << "[ERROR] --in-place and --update-from need an existing " << image->width << "x" << image->height
+                << " output image, and no --crop" << std::endl;
+      exit(1);
+    }
   }
 
   std::cout << "Rendering " << image->width << "x" << image->height << " pixels..." << std::endl;
 
+  if (cmd.relightEdits > 0)
+  {
+    try
+    {
+      relightBenchmark(cmd.relightEdits, scene, camera, image);
+    }
+    catch (std::exception const &e)
+    {
+      std::cerr << "[ERROR] " << e.what() << std::endl;
+      exit(1);
+    }
+    std::cout << "Writing file: " << outpath << std::endl;
+    image->writeFile(outpath);
+    delete scene;
+    delete camera;
+    delete image;
+    return 0;
+  }
+
   auto begin = std::chrono::high_resolution_clock::now();
-  camera->render(*image, *scene);
+  if (cmd.processes > 1)
+  {
+    if (!renderWithProcesses(cmd.processes, outpath, scene, camera, image))
+    {
+      exit(1);
+    }
+  }
+  else
+  {
+    try
+    {
+      camera->render(*image, *scene);
+    }
+    catch (std::exception const &e)
+    {
+      std::cerr << "[ERROR] " << e.what() << std::endl;
+      exit(1);
+    }
+  }
   auto end = std::chrono::high_resolution_clock::now();
   auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin);
 
   std::cout << "Done." << std::endl;
   std::printf("Total time: %.3f seconds.\n", elapsed.count() * 1e-9);
 
-  std::cout << "Writing file: " << outpath << std::endl;
-  image->writeFile(outpath);
+  if (!cmd.partial.empty())
+  {
+    std::cout << "Writing partial render: " << cmd.partial << std::endl;
+    if (!writePartial(cmd.partial, scene, camera, image))
+    {
+      exit(1);
+    }
+  }
+  else
+  {
+    std::cout << "Writing file: " << outpath << std::endl;
+    image->writeFile(outpath);
+    if (cache)
+    {
+      cache->store(scene->contentHash, outpath);
+      cache->printStats(std::cout);
+    }
+  }
 
   delete scene;
   delete camera;
@@ -0,0 +1,210 @@
+#include <stdexcept>
+#include <filesystem>
+#include <fstream>
+#include "Raytracer.hpp"
+#include "../json/json.hpp"
+#include "../rayscene/SceneLoader.hpp"
+
+using json = nlohmann::json;
+
+struct Raytracer::State
+{
+  json data;
+  std::filesystem::path directory;
+  json overrides = json::object();
+
+  std::unique_ptr<Scene> scene;
+  std::unique_ptr<Camera> camera;
+  std::unique_ptr<Image> image;
+  int rendersOfScene = 0;
+  // Primary hits kept by relight(), for the current camera and geometry
+  GBuffer gbuffer;
+
+  // Scene data with the render options merged into its "render" section
+  json withOverrides(json const &sceneData) const
+  {
+    json merged = sceneData;
+    if (!overrides.empty())
+    {
+      merged["render"].merge_patch(overrides);
+    }
+    return merged;
+  }
+
+  // Camera and image for the current render options (the scene is kept)
+  void loadView()
+  {
+    json merged = withOverrides(data);
+    auto [newCamera, newImage] = SceneLoader::LoadView(merged);
+    std::unique_ptr<Camera> loadedCamera(newCamera);
+    std::unique_ptr<Image> loadedImage(newImage);
+    uint64_t hash = SceneLoader::Hash(merged, directory);
+
+    camera = std::move(loadedCamera);
+    image = std::move(loadedImage);
+    scene->contentHash = hash;
+    gbuffer.clear();
+  }
+
+  // Everything is loaded first: on an error, the previous scene stays as it was
+  void load(json sceneData, std::filesystem::path sceneDirectory)
+  {
+    std::unique_ptr<Scene> loaded(SceneLoader::LoadScene(sceneData, sceneDirectory));
+    json merged = withOverrides(sceneData);
+    auto [newCamera, newImage] = SceneLoader::LoadView(merged);
+    std::unique_ptr<Camera> loadedCamera(newCamera);
+    std::unique_ptr<Image> loadedImage(newImage);
+    loaded->contentHash = SceneLoader::Hash(merged, sceneDirectory);
+
+    data = sceneData;
+    directory = sceneDirectory;
+    scene = std::move(loaded);
+    camera = std::move(loadedCamera);
+    image = std::move(loadedImage);
+    rendersOfScene = 0;
+    gbuffer.clear();
+  }
+};
+
+// JSON errors are reported as std::runtime_error, like the other errors
+static json parseJson(std::string const &text)
+{
+  try
+  {
+    return json::parse(text);
+  }
+  catch (json::exception const &e)
+  {
+    throw std::runtime_error(e.what());
+  }
+}
+
+Raytracer::Raytracer() : state(std::make_unique<State>())
+{
+}
+
+Raytracer::~Raytracer()
+{
+}
+
+void Raytracer::loadFile(std::string const &path)
+{
+  std::ifstream f(path);
+  if (!f.good())
+  {
+    throw std::runtime_error("Scene file not found at path: " + path);
+  }
+  std::string text((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+  state->load(parseJson(text), std::filesystem::path(path).parent_path());
+}
+
+void Raytracer::loadJson(std::string const &sceneJson, std::string const &directory)
+{
+  state->load(parseJson(sceneJson), directory);
+}
+
+void Raytracer::setRenderOptions(std::string const &renderJson)
+{
+  json options = parseJson(renderJson);
+  if (!options.is_object())
+  {
+    throw std::runtime_error("render options must be a JSON object");
+  }
+  json previous = state->overrides;
+  state->overrides.merge_patch(options);
+  if (state->scene)
+  {
+    try
+    {
+      state->loadView();
+    }
+    catch (...)
+    {
+      state->overrides = previous;
+      throw;
+    }
+  }
+}
+
+int Raytracer::getWidth() const
+{
+  return state->image ? state->image->width : 0;
+}
+
+int Raytracer::getHeight() const
+{
+  return state->image ? state->image->height : 0;
+}
+
+void Raytracer::render(unsigned char *rgba, size_t stride)
+{
+  if (!state->scene)
+  {
+    throw std::runtime_error("no scene loaded");
+  }
+  state->camera->render(*state->image, *state->scene);
+  state->image->toRGBA(rgba, stride > 0 ? stride : 4 * (size_t)state->image->width);
+  state->rendersOfScene++;
+}
+
+void Raytracer::setLights(std::string const &lightsJson)
+{
+  json lights = parseJson(lightsJson);
+  if (!lights.is_array())
+  {
+    throw std::runtime_error("lights must be a JSON array");
+  }
+  if (!state->scene)
+  {
+    throw std::runtime_error("no scene loaded");
+  }
+  json section = {{"lights", lights}};
+  SceneLoader::LoadLights(section, state->scene.get());
+  state->data["lights"] = lights;
+  state->scene->contentHash = SceneLoader::Hash(state->data, state->directory);
+}
+
+void Raytracer::setMaterials(std::string const &materialsJson)
+{
+  json materials = parseJson(materialsJson);
+  if (!materials.is_object())
+  {
+    throw std::runtime_error("materials must be a JSON object");
+  }
+  if (!state->scene)
+  {
+    throw std::runtime_error("no scene loaded");
+  }
+  json section = {{"materials", materials}};
+  SceneLoader::LoadMaterials(section, state->scene.get());
+  state->data["materials"].merge_patch(materials);
+  state->scene->contentHash = SceneLoader::Hash(state->data, state->directory);
+}
+
+void Raytracer::relight(unsigned char *rgba, size_t stride)
+{
+  if (!state->scene)
+  {
+    throw std::runtime_error("no scene loaded");
+  }
+  state->camera->relight(*state->image, *state->scene, state->gbuffer);
+  state->image->toRGBA(rgba, stride > 0 ? stride : 4 * (size_t)state->image->width);
+  state->rendersOfScene++;
+}
+
+RaytracerStats Raytracer::getStats() const
+{
+  RaytracerStats stats;
+  if (state->camera)
+  {
+    RenderStats const &last = state->camera->Stats;
+    stats.width = getWidth();
+    stats.height = getHeight();
+    stats.renderSeconds = last.seconds;
+    stats.threads = last.threads;
+    stats.primaryRays = last.tracedPixels;
+    stats.antialiasingRays = last.extraSamples;
+  }
+  stats.rendersOfScene = state->rendersOfScene;
+  return stats;
+}
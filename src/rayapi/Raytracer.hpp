@@ -0,0 +1,84 @@
+#pragma once
+
+#include <string>
+#include <memory>
+#include <cstddef>
+
+/**
+ * Figures of the last render, see Raytracer::getStats().
+ */
+struct RaytracerStats
+{
+  int width = 0;
+  int height = 0;
+  double renderSeconds = 0;
+  int threads = 0;
+  // Primary rays (first sample of each pixel) and anti-aliasing rays
+  long primaryRays = 0;
+  long antialiasingRays = 0;
+  // Renders of the same loaded scene reuse its prepared geometry
+  int rendersOfScene = 0;
+};
+
+/**
+ * Embeddable renderer: loads a scene from a file or from memory, renders it
+ * into a buffer owned by the caller, as many times as needed.
+ *
+ * Only standard types cross this interface (the implementation is hidden),
+ * so that it stays stable when the renderer internals change.
+ * Errors (invalid scene, invalid settings) throw std::runtime_error.
+ * A Raytracer must not be used from several threads at once; each render
+ * runs on the shared render thread pool.
+ */
+class Raytracer
+{
+private:
+  struct State;
+  std::unique_ptr<State> state;
+
+public:
+  Raytracer();
+  ~Raytracer();
+  Raytracer(Raytracer const &) = delete;
+  Raytracer &operator=(Raytracer const &) = delete;
+
+  // Scene file (JSON), its OBJ files being relative to its directory
+  void loadFile(std::string const &path);
+  // Scene JSON in memory, its OBJ files being relative to `directory`
+  void loadJson(std::string const &sceneJson, std::string const &directory = ".");
+
+  /**
+   * Overrides the "render" section of the scene (JSON object, same keys as
+   * the scene file), e.g. {"threads": 4, "antialiasing": {"mode": "adaptive"}}.
+   * Kept for the next renders, and for the next scenes loaded.
+   */
+  void setRenderOptions(std::string const &renderJson);
+
+  // Size of the rendered image (the region when it is cropped)
+  int getWidth() const;
+  int getHeight() const;
+
+  /**
+   * Renders the loaded scene into `rgba`: getHeight() rows of getWidth()
+   * 8-bit RGBA pixels, `stride` bytes apart (0 = 4 * getWidth()).
+   */
+  void render(unsigned char *rgba, size_t stride = 0);
+
+  /**
+   * Lighting edits, the geometry and the camera being kept: replaces the lights
+   * (JSON array, as the "lights" section of a scene file), or the named
+   * materials (JSON object, as the "materials" section).
+   */
+  void setLights(std::string const &lightsJson);
+  void setMaterials(std::string const &materialsJson);
+
+  /**
+   * Renders like render(), re-shading the primary hits kept by the previous
+   * relight(): only the shadow and reflection rays are traced. The first call
+   * (and the first one after loading a scene or changing the render options)
+   * traces the camera rays and keeps their hits. No anti-aliasing.
+   */
+  void relight(unsigned char *rgba, size_t stride = 0);
+
+  RaytracerStats getStats() const;
+};
@@ -0,0 +1,55 @@
+#ifndef RAYTRACER_H
+#define RAYTRACER_H
+
+/*
+ * C interface of the embeddable renderer (see Raytracer.hpp).
+ * Functions returning int return 0 on success and -1 on error; the message
+ * of the last error is given by rt_last_error().
+ */
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+  typedef struct rt_renderer rt_renderer;
+
+  typedef struct rt_stats
+  {
+    int width;
+    int height;
+    double render_seconds;
+    int threads;
+    long primary_rays;
+    long antialiasing_rays;
+  } rt_stats;
+
+  rt_renderer *rt_create(void);
+  void rt_destroy(rt_renderer *renderer);
+
+  int rt_load_file(rt_renderer *renderer, const char *path);
+  /* directory: where the OBJ files of the scene are (NULL = current directory) */
+  int rt_load_json(rt_renderer *renderer, const char *scene_json, const char *directory);
+  /* JSON object overriding the "render" section of the scene */
+  int rt_set_render_options(rt_renderer *renderer, const char *render_json);
+
+  int rt_get_size(const rt_renderer *renderer, int *width, int *height);
+  /* height rows of width 8-bit RGBA pixels, stride bytes apart (0 = 4 * width) */
+  int rt_render_rgba8(rt_renderer *renderer, unsigned char *buffer, size_t stride);
+
+  /* Relighting: JSON array of lights, JSON object of named materials */
+  int rt_set_lights(rt_renderer *renderer, const char *lights_json);
+  int rt_set_materials(rt_renderer *renderer, const char *materials_json);
+  /* Like rt_render_rgba8, re-shading the primary hits kept by the previous call */
+  int rt_relight_rgba8(rt_renderer *renderer, unsigned char *buffer, size_t stride);
+  int rt_get_stats(const rt_renderer *renderer, rt_stats *stats);
+
+  const char *rt_last_error(const rt_renderer *renderer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
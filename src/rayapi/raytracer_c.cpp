@@ -0,0 +1,129 @@
+#include <string>
+#include <exception>
+#include "raytracer.h"
+#include "Raytracer.hpp"
+
+struct rt_renderer
+{
+  Raytracer raytracer;
+  std::string error;
+};
+
+// Runs an API call, turning its exceptions into the error code (no exception crosses the C interface)
+template <typename Call>
+int guarded(rt_renderer *renderer, Call call)
+{
+  if (renderer == nullptr)
+  {
+    return -1;
+  }
+  try
+  {
+    call();
+    renderer->error.clear();
+    return 0;
+  }
+  catch (std::exception const &e)
+  {
+    renderer->error = e.what();
+  }
+  catch (...)
+  {
+    renderer->error = "unknown error";
+  }
+  return -1;
+}
+
+extern "C"
+{
+  rt_renderer *rt_create(void)
+  {
+    try
+    {
+      return new rt_renderer();
+    }
+    catch (...)
+    {
+      return nullptr;
+    }
+  }
+
+  void rt_destroy(rt_renderer *renderer)
+  {
+    delete renderer;
+  }
+
+  int rt_load_file(rt_renderer *renderer, const char *path)
+  {
+    return guarded(renderer, [&]()
+                   { renderer->raytracer.loadFile(path); });
+  }
+
+  int rt_load_json(rt_renderer *renderer, const char *scene_json, const char *directory)
+  {
+    return guarded(renderer, [&]()
+                   { renderer->raytracer.loadJson(scene_json, directory != nullptr ? directory : "."); });
+  }
+
+  int rt_set_render_options(rt_renderer *renderer, const char *render_json)
+  {
+    return guarded(renderer, [&]()
+                   { renderer->raytracer.setRenderOptions(render_json); });
+  }
+
+  int rt_get_size(const rt_renderer *renderer, int *width, int *height)
+  {
+    if (renderer == nullptr || width == nullptr || height == nullptr)
+    {
+      return -1;
+    }
+    *width = renderer->raytracer.getWidth();
+    *height = renderer->raytracer.getHeight();
+    return 0;
+  }
+
+  int rt_render_rgba8(rt_renderer *renderer, unsigned char *buffer, size_t stride)
+  {
+    return guarded(renderer, [&]()
+                   { renderer->raytracer.render(buffer, stride); });
+  }
+
+  int rt_set_lights(rt_renderer *renderer, const char *lights_json)
+  {
+    return guarded(renderer, [&]()
+                   { renderer->raytracer.setLights(lights_json); });
+  }
+
+  int rt_set_materials(rt_renderer *renderer, const char *materials_json)
+  {
+    return guarded(renderer, [&]()
+                   { renderer->raytracer.setMaterials(materials_json); });
+  }
+
+  int rt_relight_rgba8(rt_renderer *renderer, unsigned char *buffer, size_t stride)
+  {
+    return guarded(renderer, [&]()
+                   { renderer->raytracer.relight(buffer, stride); });
+  }
+
+  int rt_get_stats(const rt_renderer *renderer, rt_stats *stats)
+  {
+    if (renderer == nullptr || stats == nullptr)
+    {
+      return -1;
+    }
+    RaytracerStats last = renderer->raytracer.getStats();
+    stats->width = last.width;
+    stats->height = last.height;
+    stats->render_seconds = last.renderSeconds;
+    stats->threads = last.threads;
+    stats->primary_rays = last.primaryRays;
+    stats->antialiasing_rays = last.antialiasingRays;
+    return 0;
+  }
+
+  const char *rt_last_error(const rt_renderer *renderer)
+  {
+    return renderer != nullptr ? renderer->error.c_str() : "no renderer";
+  }
+}
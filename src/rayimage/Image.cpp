@@ -1,61 +1,96 @@
 #include <iostream>
 #include <cmath>
+#include <cstdlib>
+#include <algorithm>
 #include "Image.hpp"
 #include "../lodepng/lodepng.h"
+#include "../raythread/ThreadPool.hpp"
 
 
-Image:: Image(unsigned int w, unsigned int h) : width(w), height(h)
+/**
+ * A black image is all zero bits: calloc gives zero pages that are not touched here.
+ * Each page of the framebuffer is physically allocated by the first thread
+ * writing to it (first-touch policy), i.e. by the render thread owning the
+ * tiles of that part of the image, on its own NUMA node.
+ */
+Image:: Image(unsigned int w, unsigned int h) : size((size_t)w * h), width(w), height(h)
 {  
-  buffer.resize(width * height);
-  for (int i = 0; i < buffer.size(); ++i) {
-    buffer[i] = Color();
-  }
+  buffer = static_cast<Color *>(std::calloc(std::max(size, (size_t)1), sizeof(Color)));
+  if (buffer == nullptr) { throw std::bad_alloc(); }
 }
 
-Image:: Image(unsigned int w, unsigned int h, Color c) : width(w), height(h)
+Image:: Image(unsigned int w, unsigned int h, Color c) : Image(w, h)
 {  
-  buffer.resize(width * height);
-  for (int i = 0; i < buffer.size(); ++i) {
+  for (size_t i = 0; i < size; ++i) {
     buffer[i] = c;
   }
 }
 
 Image::~ Image()
 {
+  std::free(buffer);
 }
 
 
 void Image::setPixel(unsigned int x, unsigned int y, Color color) {
   unsigned int index = (y * width) + x;
 
-  if (index >= buffer.size()) { throw std::invalid_argument("Image: Invalid index"); }
+  if (index >= size) { throw std::invalid_argument("Image: Invalid index"); }
   buffer[index] = color;
 }
 
 Color Image::getPixel(unsigned int x, unsigned int y) {
   unsigned int index = (y * width) + x;
 
-  if (index >= buffer.size()) { throw std::invalid_argument("Image: Invalid index"); }
+  if (index >= size) { throw std::invalid_argument("Image: Invalid index"); }
   return buffer[index];
 }
 
 
+void Image::toRGBA(unsigned char *rgba, size_t stride) {
+  // Conversion to 8 bits split by rows on the shared worker pool
+  ThreadPool::shared()->parallelFor(0, height, 16, [&](int y) {
+    unsigned char *row = rgba + y * stride;
+    for(unsigned x = 0; x < width; x++) {
+      Color pixel = buffer[y * width + x];
+      int offset = x * 4;
+
+      row[offset] = (unsigned int)floor(pixel.r * 255); 
+      row[offset + 1] = (unsigned int)floor(pixel.g * 255); 
+      row[offset + 2] = (unsigned int)floor(pixel.b * 255); 
+      row[offset + 3] = 255;      // Alpha
+    }
+  });
+}
+
 void Image::writeFile(std::string& filename) {
   std::vector<unsigned char> image;
   image.resize(width * height * 4);
-  for(unsigned index = 0; index < buffer.size(); index++) {
-    Color pixel = buffer[index];
-    int offset = index * 4;
-
-    image[offset] = (unsigned int)floor(pixel.r * 255); 
-    image[offset + 1] = (unsigned int)floor(pixel.g * 255); 
-    image[offset + 2] = (unsigned int)floor(pixel.b * 255); 
-    image[offset + 3] = 255;      // Alpha
-  }
+  toRGBA(image.data(), width * 4);
+  writePNG(filename, image, width, height);
+}
 
+void Image::writePNG(std::string const &filename, std::vector<unsigned char> const &rgba, unsigned width, unsigned height) {
   //Encode the image
-  unsigned error = lodepng::encode(filename, image, width, height);
+  unsigned error = lodepng::encode(filename, rgba, width, height);
 
   //if there's an error, display it
   if(error) std::cout << "encoder error " << error << ": "<< lodepng_error_text(error) << std::endl;
-}
\ No newline at end of file
+}
+bool Image::readFile(std::string const &filename) {
+  std::vector<unsigned char> image;
+  unsigned w, h;
+  unsigned error = lodepng::decode(image, w, h, filename);
+  if(error) {
+    std::cout << "decoder error " << error << ": "<< lodepng_error_text(error) << std::endl;
+    return false;
+  }
+  if(w != width || h != height) { return false; }
+
+  // Middle of each 8-bit interval: writeFile gives back the same bytes
+  for(size_t index = 0; index < size; index++) {
+    int offset = index * 4;
+    buffer[index] = Color((image[offset] + 0.5) / 255.0, (image[offset + 1] + 0.5) / 255.0, (image[offset + 2] + 0.5) / 255.0);
+  }
+  return true;
+}
@@ -8,11 +8,15 @@ class Image
 {
 private:
   
-  std::vector<Color> buffer;
+  // Raw allocation: the pages are only mapped when first written (see constructor)
+  Color *buffer = nullptr;
+  size_t size = 0;
 public:
   Image(unsigned int w, unsigned int h);
   Image(unsigned int w, unsigned int h, Color c);
   ~ Image();
+  Image(Image const &) = delete;
+  Image &operator=(Image const &) = delete;
   unsigned int width = 0;
   unsigned int height = 0;
 
@@ -20,5 +24,11 @@ public:
   void setPixel(unsigned int x, unsigned int y, Color color);
   Color getPixel(unsigned int x, unsigned int y);
 
+  // 8-bit RGBA pixels, rows `stride` bytes apart
+  void toRGBA(unsigned char *rgba, size_t stride);
   void writeFile(std::string& filename);
+  // Encodes width x height 8-bit RGBA pixels (rows 4 * width bytes apart) to a PNG file
+  static void writePNG(std::string const &filename, std::vector<unsigned char> const &rgba, unsigned width, unsigned height);
+  // Loads a PNG file of the size of the image. Returns false if it cannot.
+  bool readFile(std::string const &filename);
 };
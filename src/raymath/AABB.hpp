@@ -21,5 +21,8 @@ public:
 
   bool intersects(const Ray &r) const;
 
+  const Vector3 &getMin() const { return Min; };
+  const Vector3 &getMax() const { return Max; };
+
   friend std::ostream &operator<<(std::ostream &_stream, AABB const &box);
 };
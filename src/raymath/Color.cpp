@@ -9,10 +9,6 @@ Color::Color(float iR, float iG, float iB) : r(iR), g(iG), b(iB)
 {
 }
 
-Color::~Color()
-{
-}
-
 /**
  * Implementation of the + operator :
  * Adding two colors is done by just adding the different components together :
@@ -27,14 +23,6 @@ Color Color::operator+(Color const &col)
   return c;
 }
 
-Color &Color::operator=(Color const &col)
-{
-  r = col.r;
-  g = col.g;
-  b = col.b;
-  return *this;
-}
-
 Color Color::operator*(float const &f)
 {
   Color c;
@@ -7,14 +7,15 @@ class Color
 public:
   Color();
   Color(float r, float g, float b);
-  ~Color();
+  // Trivially copyable: images can live in raw (calloc'ed) memory
+  ~Color() = default;
 
   float r = 0;
   float b = 0;
   float g = 0;
 
   Color operator+(Color const &col);
-  Color &operator=(Color const &col);
+  Color &operator=(Color const &col) = default;
   Color operator*(float const &f);
   Color operator*(Color const &col);
   Color operator/(float const &f);
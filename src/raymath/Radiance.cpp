@@ -0,0 +1,19 @@
+#include <iostream>
+#include <algorithm>
+#include "Radiance.hpp"
+
+Color Radiance::toColor() const
+{
+  float4 c;
+  for (int i = 0; i < 4; ++i)
+  {
+    // std::min/std::max on each lane: compiled to minps/maxps, no branch
+    c[i] = std::max(std::min(v[i], 1.0f), 0.0f);
+  }
+  return Color(c[0], c[1], c[2]);
+}
+
+std::ostream &operator<<(std::ostream &_stream, Radiance const &rad)
+{
+  return _stream << "(" << rad.r() << "," << rad.g() << "," << rad.b() << ")";
+}
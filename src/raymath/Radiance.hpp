@@ -0,0 +1,53 @@
+#pragma once
+
+#include <iostream>
+#include "Color.hpp"
+
+/**
+ * 4 x float vector (GCC/Clang vector extension):
+ * compiled to SSE on x86 and NEON on ARM, plain scalar code elsewhere.
+ * The 4th lane is padding and always stays at 0.
+ */
+typedef float float4 __attribute__((vector_size(16)));
+
+/**
+ * Linear, unclamped radiance used to accumulate light during shading.
+ * Unlike Color, the operators never clamp: the value is clamped and
+ * converted only once, when the pixel is written (toColor()).
+ *
+ * The operators are defined inline in the header on purpose: they are
+ * a single vector instruction each and are called in the shading loops.
+ */
+class Radiance
+{
+public:
+  float4 v;
+
+  Radiance() : v(float4{0, 0, 0, 0}) {}
+  Radiance(float r, float g, float b) : v(float4{r, g, b, 0}) {}
+  Radiance(Color const &col) : v(float4{col.r, col.g, col.b, 0}) {}
+
+  float r() const { return v[0]; }
+  float g() const { return v[1]; }
+  float b() const { return v[2]; }
+
+  Radiance operator+(Radiance const &rad) const { return Radiance(v + rad.v); }
+  Radiance operator*(Radiance const &rad) const { return Radiance(v * rad.v); }
+  Radiance operator*(float const &f) const { return Radiance(v * f); }
+  Radiance operator/(float const &f) const { return Radiance(v / f); }
+  Radiance &operator+=(Radiance const &rad)
+  {
+    v += rad.v;
+    return *this;
+  }
+
+  /**
+   * Clamps to [0, 1] (branch-free min/max on all lanes) and converts to a displayable color.
+   */
+  Color toColor() const;
+
+  friend std::ostream &operator<<(std::ostream &_stream, Radiance const &rad);
+
+private:
+  explicit Radiance(float4 vec) : v(vec) {}
+};
@@ -11,6 +11,14 @@ Ray::Ray(Vector3 pos, Vector3 dir) : position(pos)
   direction = dir.normalize();
 }
 
+Ray Ray::normalized(Vector3 pos, Vector3 dir)
+{
+  Ray ray;
+  ray.position = pos;
+  ray.direction = dir;
+  return ray;
+}
+
 Ray::~Ray()
 {
 }
@@ -12,6 +12,8 @@ private:
 public:
   Ray();
   Ray(Vector3 pos, Vector3 dir);
+  // Direction already normalised, kept as is (a ray stored component by component)
+  static Ray normalized(Vector3 pos, Vector3 dir);
   ~Ray();
 
   Vector3 GetPosition() const;
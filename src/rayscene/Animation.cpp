@@ -0,0 +1,85 @@
+#include <algorithm>
+#include "Animation.hpp"
+
+void KeyframeTrack::add(double frame, Vector3 const &value)
+{
+  auto position = std::upper_bound(keys.begin(), keys.end(), frame,
+                                   [](double f, std::pair<double, Vector3> const &key)
+                                   { return f < key.first; });
+  keys.insert(position, {frame, value});
+}
+
+Vector3 KeyframeTrack::sample(double frame, Vector3 const &value) const
+{
+  if (keys.empty())
+  {
+    return value;
+  }
+  if (frame <= keys.front().first)
+  {
+    return keys.front().second;
+  }
+  if (frame >= keys.back().first)
+  {
+    return keys.back().second;
+  }
+
+  size_t next = 1;
+  while (keys[next].first < frame)
+  {
+    next++;
+  }
+  auto const &a = keys[next - 1];
+  auto const &b = keys[next];
+  double t = (frame - a.first) / (b.first - a.first);
+  return a.second + (b.second - a.second) * t;
+}
+
+bool sameVector(Vector3 const &a, Vector3 const &b)
+{
+  return a.x == b.x && a.y == b.y && a.z == b.z;
+}
+
+void Animation::addObject(AnimatedObject const &object)
+{
+  objects.push_back(object);
+}
+
+void Animation::setCamera(AnimatedObject const &pose)
+{
+  camera = pose;
+  animatedCamera = true;
+}
+
+int Animation::apply(int frame, Scene &scene, Camera &view)
+{
+  int transformed = 0;
+  std::vector<SceneObject *> const &sceneObjects = scene.getObjects();
+
+  for (AnimatedObject &animated : objects)
+  {
+    Vector3 position = animated.positionKeys.sample(frame, animated.position);
+    Vector3 rotation = animated.rotationKeys.sample(frame, animated.rotation);
+    if (animated.applied && sameVector(position, animated.appliedPosition) && sameVector(rotation, animated.appliedRotation))
+    {
+      continue;
+    }
+
+    SceneObject *object = sceneObjects[animated.object];
+    object->transform.setPosition(position);
+    object->transform.setRotation(rotation);
+    scene.update(object);
+
+    animated.applied = true;
+    animated.appliedPosition = position;
+    animated.appliedRotation = rotation;
+    transformed++;
+  }
+
+  if (animatedCamera)
+  {
+    Vector3 position = camera.positionKeys.sample(frame, camera.position);
+    view.setPosition(position);
+  }
+  return transformed;
+}
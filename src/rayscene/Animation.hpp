@@ -0,0 +1,69 @@
+#pragma once
+
+#include <vector>
+#include <utility>
+#include "../raymath/Vector3.hpp"
+#include "Scene.hpp"
+#include "Camera.hpp"
+
+/**
+ * Keyframes of one animated vector (a position or a rotation), sorted by frame.
+ * Linear interpolation between two keyframes, the value of the first (last)
+ * keyframe before (after) them.
+ */
+struct KeyframeTrack
+{
+  std::vector<std::pair<double, Vector3>> keys;
+
+  void add(double frame, Vector3 const &value);
+  // `value` when there is no keyframe
+  Vector3 sample(double frame, Vector3 const &value) const;
+};
+
+/**
+ * Pose of an animated object (or of the camera) along the frames.
+ */
+struct AnimatedObject
+{
+  // Index in the scene objects
+  int object = -1;
+  // Pose given outside of the keyframes
+  Vector3 position;
+  Vector3 rotation;
+  KeyframeTrack positionKeys;
+  KeyframeTrack rotationKeys;
+
+  // Pose last applied
+  bool applied = false;
+  Vector3 appliedPosition;
+  Vector3 appliedRotation;
+};
+
+/**
+ * Keyframed transforms of the objects and keyframed camera position of a scene
+ * file. The geometry stays loaded between frames: posing the scene at a frame
+ * only transforms again the objects whose pose changed.
+ *
+ * An animation keeps track of the pose it last applied: use one per scene instance.
+ */
+class Animation
+{
+private:
+  std::vector<AnimatedObject> objects;
+  AnimatedObject camera;
+  bool animatedCamera = false;
+
+public:
+  // Frames 0 to frameCount - 1
+  int frameCount = 1;
+
+  void addObject(AnimatedObject const &object);
+  void setCamera(AnimatedObject const &pose);
+  bool empty() const { return objects.empty() && !animatedCamera; };
+
+  /**
+   * Poses the animated objects and the camera at `frame`.
+   * Returns the number of objects transformed again.
+   */
+  int apply(int frame, Scene &scene, Camera &view);
+};
@@ -1,29 +1,81 @@
 #include <iostream>
 #include <cmath>
+#include <chrono>
+#include <atomic>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
 #include "Camera.hpp"
+#include "TileScheduler.hpp"
+#include "Checkpoint.hpp"
+#include "Wavefront.hpp"
+#include "../raythread/ThreadPool.hpp"
+#include "../raythread/CacheMissCounter.hpp"
 #include "../raymath/Ray.hpp"
 
-// ============================================================================
-// EVALUATION 3: Threading Support
-// ============================================================================
-#ifdef USE_THREADING
-#include <thread>
-#include <vector>
-#endif
 
 struct RenderSegment
 {
 public:
-  int rowMin;
-  int rowMax;
   Image *image;
-  double height;
+
+  // Rendered region: tiles and baseSamples use pixel coordinates relative to its corner,
+  // which is pixel (frameX0, frameY0) of the frame and (imageX0, imageY0) of the image
+  int regionWidth;
+  int regionHeight;
+  int frameX0 = 0;
+  int frameY0 = 0;
+  int imageX0 = 0;
+  int imageY0 = 0;
+  // Camera rays: eye, image plane, and size of a pixel on the plane
+  CameraView view;
   double intervalX;
   double intervalY;
   int reflections;
   Scene *scene;
+  TileScheduler *scheduler;
+
+  // Adaptive anti-aliasing: first sample of every pixel, and counters
+  AntialiasingSettings antialiasing;
+  Radiance *baseSamples = nullptr;
+  std::atomic<long> refinedPixels{0};
+  std::atomic<long> extraSamples{0};
+
+  // Progressive rendering: one pixel out of `step` is traced in each direction,
+  // and fills a step x step block. Pixels traced by a coarser pass are skipped.
+  int step = 1;
+  int coarsestStep = 1;
+  // Passes after the first one stop at the deadline
+  bool interruptible = false;
+  std::chrono::steady_clock::time_point deadline;
+  std::atomic<bool> interrupted{false};
+  std::atomic<long> tracedPixels{0};
+
+  // Tiles rendered by this process
+  TileSubset tiles;
+  int tileSize = 1;
+
+  // Receives the finished tiles of the full resolution pass (baseSamples holds their radiance)
+  Checkpoint *checkpoint = nullptr;
+
+  // Relighting: primary hits of the region
+  GBuffer *gbuffer = nullptr;
+
+  // Wavefront integrator
+  bool sortRays = false;
+  std::atomic<long> rays{0};
+  std::atomic<long> cacheMisses{0};
+  std::atomic<bool> cacheMissesMeasured{true};
+
+  // Reflected rays traced (path termination statistics)
+  std::atomic<long> reflectionRays{0};
 };
 
+// First progressive pass: one pixel out of 8 x 8
+#define PROGRESSIVE_COARSEST_STEP 8
+
 Camera::Camera() : position(Vector3())
 {
 }
@@ -36,7 +88,7 @@ Camera::~Camera()
 {
 }
 
-Vector3 Camera::getPosition()
+Vector3 Camera::getPosition() const
 {
   return position;
 }
@@ -47,125 +99,780 @@ void Camera::setPosition(Vector3 &pos)
 }
 
 /**
- * Render a segment (set of rows) of the image
+ * Primary ray going through the point (px, py) of the region, in pixels
+ * (pixel (x, y) covers [x, x + 1[ x [y, y + 1[, its first sample is at its corner).
+ */
+Ray primaryRay(RenderSegment *segment, double px, double py)
+{
+  CameraView const &view = segment->view;
+  px += segment->frameX0;
+  py += segment->frameY0;
+  double yCoord = (view.height / 2.0) - (py * segment->intervalY);
+  double xCoord = -(view.width / 2.0) + (px * segment->intervalX);
+
+  Vector3 coord = view.center + (view.right * xCoord + view.up * yCoord);
+  return Ray(view.eye, coord - view.eye);
+}
+
+/**
+ * Camera rays of the pixels x0, x0 + step... (before x1) of the row y of the
+ * region: the same rays as primaryRay, generated together. The terms of the
+ * row are computed once, then the directions of the whole row are computed
+ * and normalised component by component, in loops the compiler vectorises
+ * (this file is built with -fno-math-errno: sqrt has no errno branch).
  */
-void renderSegment(RenderSegment *segment)
+struct PrimaryRow
+{
+  Vector3 eye;
+  std::vector<double> dx, dy, dz;
+
+  Ray get(size_t i) const { return Ray::normalized(eye, Vector3(dx[i], dy[i], dz[i])); };
+};
+
+void primaryRow(RenderSegment *segment, int y, int x0, int x1, int step, PrimaryRow &row)
+{
+  CameraView const &view = segment->view;
+  const size_t count = x1 > x0 ? (x1 - x0 + step - 1) / step : 0;
+  row.eye = view.eye;
+  row.dx.resize(count);
+  row.dy.resize(count);
+  row.dz.resize(count);
+
+  double yCoord = (view.height / 2.0) - ((double)(y + segment->frameY0) * segment->intervalY);
+  const Vector3 vertical = view.up * yCoord;
+  const double left = -(view.width / 2.0);
+  double *dx = row.dx.data();
+  double *dy = row.dy.data();
+  double *dz = row.dz.data();
+
+  // The operations of primaryRay, in the same order: the same bits
+  for (size_t i = 0; i < count; ++i)
+  {
+    double xCoord = left + ((double)(x0 + (int)i * step + segment->frameX0) * segment->intervalX);
+    dx[i] = (view.center.x + (view.right.x * xCoord + vertical.x)) - view.eye.x;
+    dy[i] = (view.center.y + (view.right.y * xCoord + vertical.y)) - view.eye.y;
+    dz[i] = (view.center.z + (view.right.z * xCoord + vertical.z)) - view.eye.z;
+  }
+  // Vector3::normalize (never 0: the rays go forward)
+  for (size_t i = 0; i < count; ++i)
+  {
+    double invLength = 1.0 / std::sqrt(dx[i] * dx[i] + dy[i] * dy[i] + dz[i] * dz[i]);
+    dx[i] *= invLength;
+    dy[i] *= invLength;
+    dz[i] *= invLength;
+  }
+}
+
+// Traces the primary ray going through the point (px, py) of the region
+Radiance tracePrimary(RenderSegment *segment, double px, double py)
 {
+  Ray ray = primaryRay(segment, px, py);
+  return segment->scene->raycast(ray, ray, 0, segment->reflections);
+}
 
-  for (int y = segment->rowMin; y < segment->rowMax; ++y)
+// Stores a traced pixel: in the image (filling a step x step block) and in the base samples
+void writePixel(RenderSegment *segment, int x, int y, Radiance const &pixel)
+{
+  const int step = segment->step;
+  if (segment->baseSamples != nullptr)
   {
-    double yCoord = (segment->height / 2.0) - (y * segment->intervalY);
+    segment->baseSamples[y * segment->regionWidth + x] = pixel;
+  }
 
-    for (int x = 0; x < segment->image->width; ++x)
+  // Clamp once, at output
+  Color color = pixel.toColor();
+  for (int by = y; by < std::min(y + step, segment->regionHeight); ++by)
+  {
+    for (int bx = x; bx < std::min(x + step, segment->regionWidth); ++bx)
     {
-      double xCoord = -0.5 + (x * segment->intervalX);
+      segment->image->setPixel(segment->imageX0 + bx, segment->imageY0 + by, color);
+    }
+  }
+}
+
+/**
+ * Calls f(x, y, camera ray) for the pixels of the tile traced by the current
+ * pass, the rays being generated row by row
+ */
+template <typename F>
+void forEachTracedPixel(RenderSegment *segment, Tile const &tile, F f)
+{
+  thread_local PrimaryRow row;
+  const int step = segment->step;
 
-      Vector3 coord(xCoord, yCoord, 0);
-      Vector3 origin(0, 0, -1);
-      Ray ray(origin, coord - origin);
+  // First multiple of step inside the tile
+  const int firstX = (tile.x0 + step - 1) / step * step;
+  const int firstY = (tile.y0 + step - 1) / step * step;
 
-      Color pixel = segment->scene->raycast(ray, ray, 0, segment->reflections);
-      segment->image->setPixel(x, y, pixel);
+  for (int y = firstY; y < tile.y1; y += step)
+  {
+    // On the rows of the previous (twice coarser) pass, the pixels it traced
+    // (multiples of 2 * step) are skipped: only the ones in between get a ray
+    int x0 = firstX;
+    int stride = step;
+    if (step < segment->coarsestStep && y % (2 * step) == 0)
+    {
+      x0 = firstX % (2 * step) == 0 ? firstX + step : firstX;
+      stride = 2 * step;
+    }
+    primaryRow(segment, y, x0, tile.x1, stride, row);
+    for (int x = x0, i = 0; x < tile.x1; x += stride, ++i)
+    {
+      f(x, y, row.get(i));
     }
   }
 }
 
-void Camera::render(Image &image, Scene &scene)
+/**
+ * Render a tile of the image
+ */
+void renderTile(RenderSegment *segment, Tile const &tile)
+{
+  long traced = 0;
+  forEachTracedPixel(segment, tile, [&](int x, int y, Ray ray)
+                     {
+                       writePixel(segment, x, y, segment->scene->raycast(ray, ray, 0, segment->reflections));
+                       traced++; });
+  segment->tracedPixels += traced;
+}
+
+/**
+ * renderTile with the wavefront integrator: the camera rays of the tile are
+ * traced together, stage by stage. Same pixels.
+ */
+void wavefrontTile(RenderSegment *segment, Tile const &tile)
 {
+  // Queues reused from tile to tile by each render thread
+  thread_local Wavefront wavefront;
+  thread_local RayQueue cameraRays;
+  thread_local std::vector<int> pixels;
+  thread_local std::vector<Radiance> radiance;
+  thread_local CacheMissCounter cacheMisses;
+
+  cameraRays.clear();
+  pixels.clear();
+  forEachTracedPixel(segment, tile, [&](int x, int y, Ray const &ray)
+                     {
+                       cameraRays.push(ray, pixels.size() / 2);
+                       pixels.push_back(x);
+                       pixels.push_back(y); });
+
+  const long rays = wavefront.tracedRays;
+  const long misses = cacheMisses.read();
+  wavefront.sortRays = segment->sortRays;
+  wavefront.trace(*segment->scene, cameraRays, segment->reflections, radiance);
+  segment->rays += wavefront.tracedRays - rays;
+  segment->cacheMisses += cacheMisses.read() - misses;
+  if (!cacheMisses.available())
+  {
+    segment->cacheMissesMeasured = false;
+  }
+  for (size_t i = 0; i < cameraRays.size(); ++i)
+  {
+    writePixel(segment, pixels[2 * i], pixels[2 * i + 1], radiance[i]);
+  }
+  segment->tracedPixels += cameraRays.size();
+}
 
-  double ratio = (double)image.width / (double)image.height;
-  double height = 1.0 / ratio;
+/**
+ * Offset of the n-th sample of a pixel from its base sample, in [-0.5, 0.5[:
+ * R2 low-discrepancy sequence (well spread for any number of samples), the
+ * sample 0 being the base sample. The footprint of a refined pixel is centered
+ * on the point where the pixels that are not refined are sampled.
+ */
+void samplePosition(int n, double &ox, double &oy)
+{
+  if (n == 0)
+  {
+    ox = 0;
+    oy = 0;
+    return;
+  }
+  ox = std::fmod(0.5 + n * 0.7548776662466927, 1.0) - 0.5;
+  oy = std::fmod(0.5 + n * 0.5698402909980532, 1.0) - 0.5;
+}
 
-  double intervalX = 1.0 / (double)image.width;
-  double intervalY = height / (double)image.height;
+// Weight of a sample at offset (dx, dy) from the base sample: highest at the base sample
+float filterWeight(ReconstructionFilter filter, double dx, double dy)
+{
+  switch (filter)
+  {
+  case FILTER_TENT:
+    return (1.0 - std::fabs(dx)) * (1.0 - std::fabs(dy));
+  case FILTER_GAUSSIAN:
+    // sigma = 1/4 pixel
+    return std::exp(-(dx * dx + dy * dy) * 8.0);
+  default:
+    return 1;
+  }
+}
 
-  scene.prepare();
+/**
+ * Largest difference (over r, g, b, after clamping) between a pixel and its 8 neighbours
+ */
+float neighbourContrast(RenderSegment *segment, int x, int y)
+{
+  const int width = segment->regionWidth;
+  const int height = segment->regionHeight;
+  Color center = segment->baseSamples[y * width + x].toColor();
+  float contrast = 0;
 
-// ============================================================================
-// EVALUATION 3: Multithreading Implementation
-// ============================================================================
-#ifdef USE_THREADING
+  for (int ny = std::max(y - 1, 0); ny <= std::min(y + 1, height - 1); ++ny)
+  {
+    for (int nx = std::max(x - 1, 0); nx <= std::min(x + 1, width - 1); ++nx)
+    {
+      Color neighbour = segment->baseSamples[ny * width + nx].toColor();
+      contrast = std::max(contrast, std::fabs(neighbour.r - center.r));
+      contrast = std::max(contrast, std::fabs(neighbour.g - center.g));
+      contrast = std::max(contrast, std::fabs(neighbour.b - center.b));
+    }
+  }
+  return contrast;
+}
 
-  // Get the number of hardware threads available
-  unsigned int nthreads = std::thread::hardware_concurrency();
+/**
+ * Adaptive anti-aliasing pass: adds samples to the pixels of the tile whose
+ * neighbourhood has contrast, until their variance is low enough.
+ * Only reads the base samples, so tiles can be refined in any order.
+ */
+void refineTile(RenderSegment *segment, Tile const &tile)
+{
+  AntialiasingSettings const &aa = segment->antialiasing;
+  long refined = 0;
+  long samples = 0;
 
-  // Fallback to 4 threads if hardware_concurrency returns 0
-  if (nthreads == 0)
+  for (int y = tile.y0; y < tile.y1; ++y)
   {
-    nthreads = 4;
+    for (int x = tile.x0; x < tile.x1; ++x)
+    {
+      if (neighbourContrast(segment, x, y) <= aa.threshold)
+      {
+        continue;
+      }
+
+      Radiance base = segment->baseSamples[y * segment->regionWidth + x];
+      float weight = filterWeight(aa.filter, 0, 0);
+      Radiance sum = base * weight;
+      float weightSum = weight;
+
+      // Running variance of the (clamped) luminance of the samples
+      Color c = base.toColor();
+      double mean = (c.r + c.g + c.b) / 3.0;
+      double m2 = 0;
+
+      int n = 1;
+      while (n < aa.maxSamples)
+      {
+        double ox, oy;
+        samplePosition(n, ox, oy);
+        Radiance sample = tracePrimary(segment, x + ox, y + oy);
+
+        weight = filterWeight(aa.filter, ox, oy);
+        sum = sum + sample * weight;
+        weightSum += weight;
+        n++;
+
+        c = sample.toColor();
+        double luminance = (c.r + c.g + c.b) / 3.0;
+        double delta = luminance - mean;
+        mean += delta / n;
+        m2 += delta * (luminance - mean);
+
+        // Standard error of the mean small enough: stop
+        if (n >= aa.minSamples && std::sqrt(m2 / (n - 1) / n) < aa.threshold * 0.5)
+        {
+          break;
+        }
+      }
+
+      refined++;
+      samples += n - 1;
+      segment->image->setPixel(segment->imageX0 + x, segment->imageY0 + y, (sum / weightSum).toColor());
+    }
   }
 
-  std::cout << "Rendering with " << nthreads << " threads..." << std::endl;
+  segment->refinedPixels += refined;
+  segment->extraSamples += samples;
+}
+
+/**
+ * Anti-aliasing compares each pixel with its neighbours. When only a subset of
+ * the tiles is rendered, the pixels of this (skipped) tile next to a rendered
+ * tile are traced too, as base samples only (not written to the image): the
+ * refined pixels are then the same as when rendering the whole frame.
+ */
+void traceApron(RenderSegment *segment, Tile const &tile)
+{
+  const int width = segment->regionWidth;
+  const int height = segment->regionHeight;
+  const int tileSize = segment->tileSize;
+  const int columns = (width + tileSize - 1) / tileSize;
 
-  std::vector<std::thread> threads;
-  std::vector<RenderSegment *> segments;
+  for (int y = tile.y0; y < tile.y1; ++y)
+  {
+    for (int x = tile.x0; x < tile.x1; ++x)
+    {
+      // Only the border of the tile touches other tiles
+      if (x != tile.x0 && x != tile.x1 - 1 && y != tile.y0 && y != tile.y1 - 1)
+      {
+        continue;
+      }
+
+      bool nextToRendered = false;
+      for (int ny = std::max(y - 1, 0); ny <= std::min(y + 1, height - 1); ++ny)
+      {
+        for (int nx = std::max(x - 1, 0); nx <= std::min(x + 1, width - 1); ++nx)
+        {
+          nextToRendered |= segment->tiles.contains((ny / tileSize) * columns + nx / tileSize);
+        }
+      }
+      if (nextToRendered)
+      {
+        segment->baseSamples[y * width + x] = tracePrimary(segment, x, y);
+      }
+    }
+  }
+}
 
-  // Calculate rows per thread
-  int rowsPerThread = image.height / nthreads;
-  int remainingRows = image.height % nthreads;
+/**
+ * Relighting: shades the primary hits of the tile stored in the G-buffer,
+ * which only traces the shadow and reflection rays. While the G-buffer is
+ * filled (`capture`), the camera rays are traced and their hits stored first.
+ * Same pixels as renderTile.
+ */
+template <bool capture>
+void relightTile(RenderSegment *segment, Tile const &tile)
+{
+  GBuffer &gbuffer = *segment->gbuffer;
+  thread_local PrimaryRow row;
+  long traced = 0;
 
-  // Divide the image into segments
-  int currentRow = 0;
-  for (unsigned int i = 0; i < nthreads; ++i)
+  for (int y = tile.y0; y < tile.y1; ++y)
   {
-    RenderSegment *seg = new RenderSegment();
-    seg->height = height;
-    seg->image = &image;
-    seg->scene = &scene;
-    seg->intervalX = intervalX;
-    seg->intervalY = intervalY;
-    seg->reflections = Reflections;
-    seg->rowMin = currentRow;
+    primaryRow(segment, y, tile.x0, tile.x1, 1, row);
+    for (int x = tile.x0; x < tile.x1; ++x)
+    {
+      const size_t i = (size_t)y * segment->regionWidth + x;
+      Ray ray = row.get(x - tile.x0);
+      Intersection hit;
+
+      if (capture)
+      {
+        gbuffer.materialID[i] = NO_MATERIAL;
+        if (segment->scene->closestIntersection(ray, hit, CULLING_FRONT))
+        {
+          gbuffer.position[i] = hit.Position;
+          gbuffer.normal[i] = hit.Normal;
+          gbuffer.view[i] = (ray.GetPosition() - hit.Position).normalize();
+          gbuffer.materialID[i] = hit.MaterialID;
+        }
+        traced++;
+      }
+
+      Radiance pixel;
+      if (gbuffer.materialID[i] != NO_MATERIAL)
+      {
+        hit.Position = gbuffer.position[i];
+        hit.Normal = gbuffer.normal[i];
+        hit.View = gbuffer.view[i];
+        hit.MaterialID = gbuffer.materialID[i];
+        pixel = segment->scene->shade(ray, ray, hit, 0, segment->reflections);
+      }
+      segment->image->setPixel(segment->imageX0 + x, segment->imageY0 + y, pixel.toColor());
+    }
+  }
 
-    // Distribute remaining rows to first threads
-    int extraRow = (i < remainingRows) ? 1 : 0;
-    seg->rowMax = currentRow + rowsPerThread + extraRow;
+  segment->tracedPixels += traced;
+}
 
-    currentRow = seg->rowMax;
+/**
+ * Render thread: pulls tiles from the scheduler until there are none left
+ */
+void renderWorker(RenderSegment *segment, int worker, void (*renderFunction)(RenderSegment *, Tile const &))
+{
+  Tile tile;
+  // Only count the reflections of this render
+  Scene::takeReflectionCount();
+  while (segment->scheduler->next(worker, tile))
+  {
+    auto begin = std::chrono::steady_clock::now();
+    if (segment->interruptible && begin > segment->deadline)
+    {
+      segment->interrupted = true;
+      return;
+    }
 
-    segments.push_back(seg);
+    renderFunction(segment, tile);
+    segment->reflectionRays += Scene::takeReflectionCount();
+    if (segment->checkpoint != nullptr)
+    {
+      segment->checkpoint->tileFinished(tile, segment->baseSamples);
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+    segment->scheduler->addBusyTime(worker, elapsed.count());
+  }
+}
 
-    // Create and launch thread
-    threads.push_back(std::thread(renderSegment, seg));
+RenderRegion Camera::getRegion(Image const &image) const
+{
+  RenderRegion region = Settings.region;
+  if (region.width <= 0 || region.height <= 0)
+  {
+    region.x = 0;
+    region.y = 0;
+    region.width = FrameWidth > 0 ? FrameWidth : image.width;
+    region.height = FrameHeight > 0 ? FrameHeight : image.height;
   }
+  return region;
+}
 
-  // Wait for all threads to complete
-  for (auto &thread : threads)
+RenderRegion Camera::prepareSegment(RenderSegment &seg, Image &image, Scene &scene)
+{
+  // The camera mapping depends on the whole frame, even when only a region of it is rendered
+  const int frameWidth = FrameWidth > 0 ? FrameWidth : image.width;
+  const int frameHeight = FrameHeight > 0 ? FrameHeight : image.height;
+
+  RenderRegion region = getRegion(image);
+  if (region.x < 0 || region.y < 0 || region.x + region.width > frameWidth || region.y + region.height > frameHeight)
+  {
+    throw std::runtime_error("region " + std::to_string(region.width) + "x" + std::to_string(region.height) + "+" +
+                             std::to_string(region.x) + "+" + std::to_string(region.y) + " is outside of the " +
+                             std::to_string(frameWidth) + "x" + std::to_string(frameHeight) + " frame");
+  }
+  // Cropped: the image only holds the region. Otherwise the region is drawn in place into the frame
+  if (region.crop ? ((int)image.width != region.width || (int)image.height != region.height)
+                  : ((int)image.width != frameWidth || (int)image.height != frameHeight))
   {
-    thread.join();
+    throw std::runtime_error(std::string("the image size does not match the ") + (region.crop ? "region" : "frame") + " size");
   }
 
-  // Clean up segments
-  for (auto *seg : segments)
+  CameraView view = getView(frameWidth, frameHeight);
+  double intervalX = view.width / (double)frameWidth;
+  double intervalY = view.height / (double)frameHeight;
+
+  seg.view = view;
+  seg.image = &image;
+  seg.regionWidth = region.width;
+  seg.regionHeight = region.height;
+  seg.frameX0 = region.x;
+  seg.frameY0 = region.y;
+  seg.imageX0 = region.crop ? 0 : region.x;
+  seg.imageY0 = region.crop ? 0 : region.y;
+  seg.tiles = Settings.tiles;
+  seg.scene = &scene;
+  seg.intervalX = intervalX;
+  seg.intervalY = intervalY;
+  seg.reflections = Reflections;
+  seg.antialiasing = Settings.antialiasing;
+  seg.tileSize = std::max(Settings.tileSize, 1);
+  seg.sortRays = Settings.sortRays;
+  return region;
+}
+
+/**
+ * Starts the shared pool and prepares the scene. Returns the number of render
+ * threads, and sets `pool` to the pool to render with (held until the end of
+ * the render, even if another render configures the shared pool meanwhile).
+ */
+int startRender(RenderSettings const &settings, Scene &scene, std::shared_ptr<ThreadPool> &pool)
+{
+  // Long-lived workers, parked between renders
+  ThreadPool::configure(settings.threads, settings.pinThreads);
+  pool = ThreadPool::shared();
+  // Rendered from inside a job (e.g. several frames at once): on the calling thread only
+  const int workers = ThreadPool::inJob() ? 1 : pool->size();
+
+  scene.prepare();
+
+  if (workers > 1)
   {
-    delete seg;
+    std::cout << "Rendering with " << workers << " threads..." << std::endl;
   }
+  else
+  {
+    std::cout << "Rendering with single thread..." << std::endl;
+  }
+  return workers;
+}
 
-  std::cout << "Rendering complete!" << std::endl;
+CameraView Camera::getView(int frameWidth, int frameHeight) const
+{
+  CameraView view;
+  // Along +z: no rounding, the historical mapping
+  view.right = Vector3(1, 0, 0);
+  view.up = Vector3(0, 1, 0);
+  view.forward = Vector3(0, 0, 1);
+  if (HasTarget)
+  {
+    Vector3 forward = Target - position;
+    Vector3 right = Up.cross(forward);
+    if (forward.lengthSquared() == 0 || right.lengthSquared() == 0)
+    {
+      throw std::runtime_error("the camera must look at a point other than its position, not along its up direction");
+    }
+    view.forward = forward.normalize();
+    view.right = right.normalize();
+    view.up = view.forward.cross(view.right);
+  }
 
-#else
+  view.center = position;
+  view.eye = position - view.forward;
+  view.width = Fov > 0 ? 2 * std::tan(Fov * M_PI / 360.0) : 1.0;
+  double aspect = Aspect > 0 ? Aspect : (double)frameWidth / (double)frameHeight;
+  view.height = view.width / aspect;
+  return view;
+}
+
+// Inverse of the mapping of primaryRay
+bool Camera::project(Vector3 const &point, double &px, double &py) const
+{
+  CameraView view = getView(FrameWidth, FrameHeight);
+  Vector3 toPoint = point - view.eye;
+  double depth = toPoint.dot(view.forward);
+  if (!(depth > 0))
+  {
+    return false;
+  }
+  // On the image plane, at distance 1
+  Vector3 onPlane = toPoint / depth;
+  px = (onPlane.dot(view.right) + view.width / 2.0) / view.width * FrameWidth;
+  py = (view.height / 2.0 - onPlane.dot(view.up)) / view.height * FrameHeight;
+  return std::isfinite(px) && std::isfinite(py);
+}
 
-  // ============================================================================
-  // Single-threaded rendering (original code)
-  // ============================================================================
-  std::cout << "Rendering with single thread..." << std::endl;
+bool Camera::projectDirection(Vector3 const &direction, double &px, double &py) const
+{
+  CameraView view = getView(FrameWidth, FrameHeight);
+  double depth = direction.dot(view.forward);
+  if (!(depth > 0))
+  {
+    return false;
+  }
+  Vector3 onPlane = direction / depth;
+  px = (onPlane.dot(view.right) + view.width / 2.0) / view.width * FrameWidth;
+  py = (view.height / 2.0 - onPlane.dot(view.up)) / view.height * FrameHeight;
+  return std::isfinite(px) && std::isfinite(py);
+}
 
-  RenderSegment *seg = new RenderSegment();
-  seg->height = height;
-  seg->image = &image;
-  seg->scene = &scene;
-  seg->intervalX = intervalX;
-  seg->intervalY = intervalY;
-  seg->reflections = Reflections;
-  seg->rowMin = 0;
-  seg->rowMax = image.height;
-  renderSegment(seg);
+void Camera::render(Image &image, Scene &scene)
+{
+  auto start = std::chrono::steady_clock::now();
+  RenderSegment seg;
+  RenderRegion region = prepareSegment(seg, image, scene);
+  std::shared_ptr<ThreadPool> pool;
+  const int workers = startRender(Settings, scene, pool);
+
+  // With a time budget: coarse pass first (always completed, so the image is
+  // never left with holes), then passes twice finer until the deadline
+  const bool progressive = Settings.timeBudget > 0;
+  seg.coarsestStep = progressive ? PROGRESSIVE_COARSEST_STEP : 1;
+  seg.deadline = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                             std::chrono::duration<double>(Settings.timeBudget));
+
+  bool checkpointing = !Settings.checkpoint.empty();
+  if (checkpointing && progressive)
+  {
+    std::cerr << "[WARNING] No checkpoint is written with a time budget" << std::endl;
+    checkpointing = false;
+  }
+  if (Settings.resume && !checkpointing)
+  {
+    throw std::runtime_error("resuming a render needs a checkpoint file");
+  }
 
-  delete seg;
+  // Adaptive anti-aliasing needs the first sample of the neighbours of each pixel,
+  // and checkpoints save the unclamped radiance of the finished tiles
+  std::vector<Radiance> baseSamples;
+  if (Settings.antialiasing.mode == AA_ADAPTIVE || checkpointing)
+  {
+    baseSamples.resize((size_t)region.width * region.height);
+    seg.baseSamples = baseSamples.data();
+  }
+
+  const int tileSize = seg.tileSize;
+  std::unique_ptr<Checkpoint> checkpoint;
+  std::vector<bool> doneTiles;
+  if (checkpointing)
+  {
+    checkpoint = std::make_unique<Checkpoint>(Settings.checkpoint, scene.contentHash, region.width, region.height,
+                                              tileSize, Settings.checkpointInterval);
+    std::string error;
+    if ((Settings.resume && !checkpoint->load(seg.baseSamples, doneTiles, error)) ||
+        !checkpoint->open(Settings.resume, error))
+    {
+      throw std::runtime_error(error);
+    }
+
+    for (int i = 0; i < (int)doneTiles.size(); ++i)
+    {
+      if (!doneTiles[i])
+      {
+        continue;
+      }
+      Tile tile = TileScheduler::gridTile(region.width, region.height, tileSize, i);
+      for (int y = tile.y0; y < tile.y1; ++y)
+      {
+        for (int x = tile.x0; x < tile.x1; ++x)
+        {
+          image.setPixel(seg.imageX0 + x, seg.imageY0 + y, baseSamples[(size_t)y * region.width + x].toColor());
+        }
+      }
+    }
+    if (Settings.resume)
+    {
+      std::cout << "Resuming from " << Settings.checkpoint << ": " << checkpoint->getTilesLoaded() << " of "
+                << TileScheduler::gridTileCount(region.width, region.height, tileSize) << " tiles already rendered" << std::endl;
+    }
+    seg.checkpoint = checkpoint.get();
+  }
+
+  int finestStep = 0;
+  Stats = RenderStats();
+  Stats.threads = workers;
+  Stats.resumedTiles = checkpoint ? checkpoint->getTilesLoaded() : 0;
+
+  for (int step = seg.coarsestStep; step >= 1; step /= 2)
+  {
+    // Small tiles pulled from work-stealing queues: threads that get the
+    // cheap parts of the image (empty sky) help with the expensive ones
+    TileScheduler scheduler(region.width, region.height, tileSize, workers, Settings.tileOrder,
+                            [&](Tile const &tile)
+                            { return Settings.tiles.contains(tile.index) && (doneTiles.empty() || !doneTiles[tile.index]); });
+    seg.scheduler = &scheduler;
+    seg.step = step;
+    seg.interruptible = progressive && step < seg.coarsestStep;
+
+    pool->run([&](int worker)
+             { renderWorker(&seg, worker, Settings.integrator == INTEGRATOR_WAVEFRONT ? wavefrontTile : renderTile); });
+
+    if (seg.interrupted)
+    {
+      break;
+    }
+    finestStep = step;
+    if (step == 1)
+    {
+      Stats.tiles = scheduler.getTileCount();
+    }
+
+    if (step == 1 && workers > 1)
+    {
+      scheduler.printStats(std::cout);
+    }
+  }
 
   std::cout << "Rendering complete!" << std::endl;
 
-#endif
+  const bool wavefront = Settings.integrator == INTEGRATOR_WAVEFRONT;
+  const bool missesMeasured = wavefront && seg.cacheMissesMeasured;
+  if (wavefront)
+  {
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::string misses = missesMeasured ? std::to_string(seg.cacheMisses.load()) : "n/a";
+    std::printf("Wavefront: %ld rays (%.2f Mrays/s)%s, cache misses: %s\n", seg.rays.load(),
+                seg.rays / elapsed.count() / 1e6, Settings.sortRays ? ", reflected rays sorted" : "", misses.c_str());
+  }
+
+  if (checkpoint)
+  {
+    checkpoint->flush(seg.baseSamples);
+    seg.checkpoint = nullptr;
+    std::printf("Checkpoint: %d tiles resumed, %d tiles written to %s\n",
+                checkpoint->getTilesLoaded(), checkpoint->getTilesWritten(), Settings.checkpoint.c_str());
+  }
+
+  if (progressive)
+  {
+    long pixels = (long)region.width * region.height;
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::printf("Progressive: %ld of %ld pixels traced (%.1f%%), finest complete pass 1/%d, %.3f s of %.3f s budget%s\n",
+                seg.tracedPixels.load(), pixels, 100.0 * seg.tracedPixels / pixels, finestStep,
+                elapsed.count(), Settings.timeBudget, seg.interrupted ? " (stopped at deadline)" : "");
+  }
+
+  // Anti-aliasing refines a complete full resolution image
+  if (Settings.antialiasing.mode == AA_ADAPTIVE && finestStep == 1)
+  {
+    if (!Settings.tiles.all())
+    {
+      TileScheduler apronScheduler(region.width, region.height, tileSize, workers, Settings.tileOrder,
+                                   [&](Tile const &tile)
+                                   { return !Settings.tiles.contains(tile.index); });
+      seg.scheduler = &apronScheduler;
+      pool->run([&](int worker)
+               { renderWorker(&seg, worker, traceApron); });
+    }
+
+    TileScheduler refineScheduler(region.width, region.height, tileSize, workers, Settings.tileOrder,
+                                  [&](Tile const &tile)
+                                  { return Settings.tiles.contains(tile.index); });
+    seg.scheduler = &refineScheduler;
+    seg.interruptible = progressive;
+
+    pool->run([&](int worker)
+             { renderWorker(&seg, worker, refineTile); });
+
+    long pixels = (long)region.width * region.height;
+    std::printf("Anti-aliasing: %ld pixels refined (%.1f%%), %.2f samples per pixel on average%s\n",
+                seg.refinedPixels.load(), 100.0 * seg.refinedPixels / pixels,
+                (double)(pixels + seg.extraSamples) / pixels, seg.interrupted ? " (stopped at deadline)" : "");
+  }
+
+  // Camera rays (first samples and anti-aliasing samples) start the paths
+  const long paths = seg.tracedPixels + seg.extraSamples;
+  const double pathDepth = paths > 0 ? 1.0 + (double)seg.reflectionRays / paths : 0;
+  if (scene.termination.threshold > 0)
+  {
+    std::printf("Reflections: %ld rays traced, average path depth %.3f (at most %d)%s\n", seg.reflectionRays.load(),
+                pathDepth, Reflections + 1, scene.termination.russianRoulette ? ", Russian roulette" : "");
+  }
+
+  Stats.tracedPixels = seg.tracedPixels;
+  Stats.refinedPixels = seg.refinedPixels;
+  Stats.extraSamples = seg.extraSamples;
+  Stats.finestStep = finestStep;
+  Stats.rays = seg.rays;
+  Stats.pathDepth = pathDepth;
+  Stats.cacheMisses = missesMeasured ? seg.cacheMisses.load() : -1;
+  Stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void Camera::relight(Image &image, Scene &scene, GBuffer &gbuffer)
+{
+  if (Settings.antialiasing.mode == AA_ADAPTIVE || Settings.timeBudget > 0 || !Settings.checkpoint.empty())
+  {
+    throw std::runtime_error("relighting does not support anti-aliasing, time budgets or checkpoints");
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  RenderSegment seg;
+  RenderRegion region = prepareSegment(seg, image, scene);
+  std::shared_ptr<ThreadPool> pool;
+  const int workers = startRender(Settings, scene, pool);
+
+  // Hits of another region (or none yet): traced again
+  const bool capture = gbuffer.width != region.width || gbuffer.height != region.height || gbuffer.empty();
+  if (capture)
+  {
+    gbuffer.resize(region.width, region.height);
+  }
+  seg.gbuffer = &gbuffer;
+
+  TileScheduler scheduler(region.width, region.height, seg.tileSize, workers, Settings.tileOrder,
+                          [&](Tile const &tile)
+                          { return Settings.tiles.contains(tile.index); });
+  seg.scheduler = &scheduler;
+  pool->run([&](int worker)
+           { renderWorker(&seg, worker, capture ? relightTile<true> : relightTile<false>); });
+
+  std::cout << (capture ? "Relighting complete (G-buffer captured)!" : "Relighting complete!") << std::endl;
+
+  Stats = RenderStats();
+  Stats.threads = workers;
+  Stats.tiles = scheduler.getTileCount();
+  Stats.tracedPixels = seg.tracedPixels;
+  Stats.finestStep = 1;
+  Stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
 }
 
 std::ostream &operator<<(std::ostream &_stream, Camera &cam)
@@ -4,23 +4,115 @@
 #include "../raymath/Vector3.hpp"
 #include "../rayimage/Image.hpp"
 #include "../rayscene/Scene.hpp"
+#include "RenderSettings.hpp"
+#include "GBuffer.hpp"
+
+/**
+ * Figures of the last render of a camera.
+ */
+struct RenderStats
+{
+  double seconds = 0;
+  int threads = 1;
+  // Tiles rendered at full resolution, and tiles restored from a checkpoint
+  int tiles = 0;
+  int resumedTiles = 0;
+  // First samples of the pixels, extra anti-aliasing samples, and pixels that got them
+  long tracedPixels = 0;
+  long extraSamples = 0;
+  long refinedPixels = 0;
+  // 1 when the full resolution was reached (progressive rendering: 1/finestStep)
+  int finestStep = 0;
+  // Wavefront integrator: rays traced (closest and any hit), and the cache
+  // misses of the render threads while tracing them (-1 if not measured)
+  long rays = 0;
+  long cacheMisses = -1;
+  // Average number of rays along the path of a camera ray (1 = no reflection)
+  double pathDepth = 0;
+};
+
+struct RenderSegment;
+
+/**
+ * Where the camera rays go: from the eye through the image plane, centered on
+ * `center` at distance 1 in front of the eye, `width` x `height` along the unit
+ * vectors `right` and `up`.
+ */
+struct CameraView
+{
+  Vector3 eye;
+  Vector3 center;
+  Vector3 right;
+  Vector3 up;
+  Vector3 forward;
+  double width;
+  double height;
+};
 
 class Camera
 {
 private:
+  // Center of the image plane, the eye being 1 behind it (position + (0, 0, -1) when looking at +z)
   Vector3 position;
 
+  // Checks the region and the image, sets the projection of the segment
+  RenderRegion prepareSegment(RenderSegment &segment, Image &image, Scene &scene);
+
 public:
   Camera();
   Camera(Vector3 pos);
   ~Camera();
 
   int Reflections = 0;
+  // Look-at camera: looks from position towards Target (along +z when not set), Up sets the roll
+  bool HasTarget = false;
+  Vector3 Target;
+  Vector3 Up = Vector3(0, 1, 0);
+  // Horizontal field of view in degrees (0 = an image plane 1 wide, about 53.13 degrees)
+  double Fov = 0;
+  // Width / height of the image plane (0 = the frame's: square pixels)
+  double Aspect = 0;
+  // Resolution of the whole frame (0 = size of the image rendered into)
+  int FrameWidth = 0;
+  int FrameHeight = 0;
+  RenderSettings Settings;
+  RenderStats Stats;
 
-  Vector3 getPosition();
+  Vector3 getPosition() const;
   void setPosition(Vector3 &pos);
 
+  // Throws std::runtime_error when the settings do not fit the image
   void render(Image &image, Scene &scene);
 
+  /**
+   * Relighting: renders like render(), but shades the primary hits stored in
+   * `gbuffer` instead of tracing the camera rays, so that only the shadow and
+   * reflection rays are traced. If `gbuffer` does not hold the hits of the
+   * rendered region, they are traced and stored first.
+   * The camera and the geometry must not change while the G-buffer is reused
+   * (lights and materials may). No anti-aliasing, time budget or checkpoint.
+   */
+  void relight(Image &image, Scene &scene, GBuffer &gbuffer);
+
+  /**
+   * The eye and the image plane for a frame of frameWidth x frameHeight pixels.
+   * Throws std::runtime_error when the camera looks at its position or along Up.
+   */
+  CameraView getView(int frameWidth, int frameHeight) const;
+
+  // Rectangle of the frame rendered into `image` (the whole frame if no region is set)
+  RenderRegion getRegion(Image const &image) const;
+
+  /**
+   * Position in the frame (pixels, FrameWidth x FrameHeight) where a point is
+   * seen. Returns false when the point is not in front of the eye.
+   */
+  bool project(Vector3 const &point, double &px, double &py) const;
+  /**
+   * Vanishing point of a direction: where the points going to infinity along it
+   * are seen. Returns false when they do not stay in front of the eye.
+   */
+  bool projectDirection(Vector3 const &direction, double &px, double &py) const;
+
   friend std::ostream &operator<<(std::ostream &_stream, Vector3 const &vec);
 };
@@ -4,6 +4,7 @@
 #include "Intersection.hpp"
 #include "Light.hpp"
 #include "Scene.hpp"
+#include "Wavefront.hpp"
 #include "Intersection.hpp"
 
 CheckerMaterial::CheckerMaterial()
@@ -14,12 +15,31 @@ CheckerMaterial::~CheckerMaterial()
 {
 }
 
+float CheckerMaterial::squareFactor(double x, double z)
+{
+  return ((int)floorf(x) % 2 == 0 && (int)floorf(z) % 2 != 0) ||
+                 ((int)floorf(x) % 2 != 0 && (int)floorf(z) % 2 == 0)
+             ? 1
+             : 0;
+}
+
 Color CheckerMaterial::getAmbient(Intersection *intersection)
 {
-  float f = ((int)floorf(intersection->Position.x) % 2 == 0 && (int)floorf(intersection->Position.z) % 2 != 0) ||
-                    ((int)floorf(intersection->Position.x) % 2 != 0 && (int)floorf(intersection->Position.z) % 2 == 0)
-                ? 1
-                : 0;
+  float f = squareFactor(intersection->Position.x, intersection->Position.z);
 
   return Ambient * f;
 }
+
+void CheckerMaterial::getAmbients(ShadingBatch const &batch, Color *ambients)
+{
+  for (size_t i = 0; i < batch.indices.size(); ++i)
+  {
+    const uint32_t h = batch.indices[i];
+    ambients[i] = Ambient * squareFactor(batch.hits->px[h], batch.hits->pz[h]);
+  }
+}
+
+std::string CheckerMaterial::signature() const
+{
+  return "checker:" + PhongMaterial::signature();
+}
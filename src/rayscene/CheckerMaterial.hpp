@@ -6,8 +6,15 @@
 class CheckerMaterial : public PhongMaterial
 {
 private:
+  // Ambient factor of the square of the point (x, z): 0 or 1
+  static float squareFactor(double x, double z);
+
+protected:
+  virtual void getAmbients(ShadingBatch const &batch, Color *ambients) override;
+
 public:
   CheckerMaterial();
   ~CheckerMaterial();
   virtual Color getAmbient(Intersection *intersection) override;
+  virtual std::string signature() const override;
 };
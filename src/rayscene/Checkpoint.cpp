@@ -0,0 +1,213 @@
+#include <iostream>
+#include <cstring>
+#include <filesystem>
+#include <unistd.h>
+#include "Checkpoint.hpp"
+#include "Hash.hpp"
+
+#define CHECKPOINT_MAGIC "RTCKPT01"
+
+struct CheckpointHeader
+{
+  char magic[8];
+  uint64_t sceneHash;
+  int32_t width;
+  int32_t height;
+  int32_t tileSize;
+  int32_t reserved;
+};
+
+struct TileRecordHeader
+{
+  int32_t index;
+  int32_t pixelCount;
+};
+
+Checkpoint::Checkpoint(std::string path, uint64_t sceneHash, int width, int height, int tileSize, double interval)
+    : path(path), sceneHash(sceneHash), width(width), height(height), tileSize(tileSize), interval(interval)
+{
+}
+
+Checkpoint::~Checkpoint()
+{
+  if (file != nullptr)
+  {
+    std::fclose(file);
+  }
+}
+
+bool Checkpoint::load(Radiance *radiance, std::vector<bool> &done, std::string &error)
+{
+  std::FILE *in = std::fopen(path.c_str(), "rb");
+  if (in == nullptr)
+  {
+    error = "cannot open checkpoint file " + path;
+    return false;
+  }
+
+  CheckpointHeader header;
+  if (std::fread(&header, sizeof(header), 1, in) != 1 || std::memcmp(header.magic, CHECKPOINT_MAGIC, 8) != 0)
+  {
+    std::fclose(in);
+    error = path + " is not a checkpoint file";
+    return false;
+  }
+  if (header.sceneHash != sceneHash)
+  {
+    std::fclose(in);
+    error = "checkpoint was written for another scene (hash " + hashToHex(header.sceneHash) +
+            ", current scene " + hashToHex(sceneHash) + ")";
+    return false;
+  }
+  if (header.width != width || header.height != height || header.tileSize != tileSize)
+  {
+    std::fclose(in);
+    error = "checkpoint was written for another image or tile size";
+    return false;
+  }
+
+  const int tileCount = TileScheduler::gridTileCount(width, height, tileSize);
+  done.assign(tileCount, false);
+  validBytes = sizeof(header);
+
+  std::vector<float> pixels;
+  TileRecordHeader record;
+  while (std::fread(&record, sizeof(record), 1, in) == 1)
+  {
+    if (record.index < 0 || record.index >= tileCount)
+    {
+      break;
+    }
+    Tile tile = TileScheduler::gridTile(width, height, tileSize, record.index);
+    int tileWidth = tile.x1 - tile.x0;
+    if (record.pixelCount != tileWidth * (tile.y1 - tile.y0))
+    {
+      break;
+    }
+
+    // A record cut short by a crash ends the valid part of the file
+    pixels.resize(record.pixelCount * 3);
+    if (std::fread(pixels.data(), sizeof(float), pixels.size(), in) != pixels.size())
+    {
+      break;
+    }
+
+    for (int i = 0; i < record.pixelCount; ++i)
+    {
+      int x = tile.x0 + i % tileWidth;
+      int y = tile.y0 + i / tileWidth;
+      radiance[(size_t)y * width + x] = Radiance(pixels[3 * i], pixels[3 * i + 1], pixels[3 * i + 2]);
+    }
+    if (!done[record.index])
+    {
+      done[record.index] = true;
+      tilesLoaded++;
+    }
+    validBytes = std::ftell(in);
+  }
+
+  std::fclose(in);
+  return true;
+}
+
+bool Checkpoint::open(bool keepLoadedTiles, std::string &error)
+{
+  if (keepLoadedTiles)
+  {
+    // Drop a partial record at the end before appending
+    std::error_code ec;
+    std::filesystem::resize_file(path, validBytes, ec);
+    file = ec ? nullptr : std::fopen(path.c_str(), "ab");
+  }
+  else
+  {
+    file = std::fopen(path.c_str(), "wb");
+    if (file != nullptr)
+    {
+      CheckpointHeader header = {};
+      std::memcpy(header.magic, CHECKPOINT_MAGIC, 8);
+      header.sceneHash = sceneHash;
+      header.width = width;
+      header.height = height;
+      header.tileSize = tileSize;
+      std::fwrite(&header, sizeof(header), 1, file);
+      std::fflush(file);
+    }
+  }
+
+  if (file == nullptr)
+  {
+    error = "cannot write checkpoint file " + path;
+    return false;
+  }
+  lastWrite = std::chrono::steady_clock::now();
+  return true;
+}
+
+void Checkpoint::writeTiles(std::vector<Tile> const &tiles, Radiance const *radiance)
+{
+  std::vector<float> pixels;
+  for (Tile const &tile : tiles)
+  {
+    pixels.clear();
+    for (int y = tile.y0; y < tile.y1; ++y)
+    {
+      for (int x = tile.x0; x < tile.x1; ++x)
+      {
+        Radiance const &pixel = radiance[(size_t)y * width + x];
+        pixels.push_back(pixel.r());
+        pixels.push_back(pixel.g());
+        pixels.push_back(pixel.b());
+      }
+    }
+
+    TileRecordHeader record = {tile.index, (int32_t)(pixels.size() / 3)};
+    std::fwrite(&record, sizeof(record), 1, file);
+    std::fwrite(pixels.data(), sizeof(float), pixels.size(), file);
+  }
+
+  // On disk before going on: the point is to survive the process being killed
+  std::fflush(file);
+  fsync(fileno(file));
+  tilesWritten += tiles.size();
+  lastWrite = std::chrono::steady_clock::now();
+}
+
+void Checkpoint::tileFinished(Tile const &tile, Radiance const *radiance)
+{
+  {
+    std::lock_guard<std::mutex> guard(pendingLock);
+    pending.push_back(tile);
+  }
+
+  // Another thread is already writing: it will be done soon enough
+  if (!writeLock.try_lock())
+  {
+    return;
+  }
+  std::chrono::duration<double> sinceWrite = std::chrono::steady_clock::now() - lastWrite;
+  if (sinceWrite.count() < interval)
+  {
+    writeLock.unlock();
+    return;
+  }
+
+  std::vector<Tile> tiles;
+  {
+    std::lock_guard<std::mutex> guard(pendingLock);
+    tiles.swap(pending);
+  }
+  writeTiles(tiles, radiance);
+  writeLock.unlock();
+}
+
+void Checkpoint::flush(Radiance const *radiance)
+{
+  std::lock_guard<std::mutex> writeGuard(writeLock);
+  std::vector<Tile> tiles;
+  {
+    std::lock_guard<std::mutex> guard(pendingLock);
+    tiles.swap(pending);
+  }
+  writeTiles(tiles, radiance);
+}
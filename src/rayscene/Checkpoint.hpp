@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include "../raymath/Radiance.hpp"
+#include "TileScheduler.hpp"
+
+/**
+ * Checkpoint of a render in progress, so that a long render stopped before
+ * the end (preempted machine, crash...) can be resumed.
+ *
+ * The file holds a header (scene hash, image and tile size) followed by one
+ * record per finished tile: its grid index and the unclamped radiance of its
+ * pixels. Records are only ever appended, so a checkpoint only writes the
+ * tiles finished since the previous one, and a record cut short by a crash
+ * is simply ignored when resuming.
+ */
+class Checkpoint
+{
+private:
+  std::string path;
+  uint64_t sceneHash;
+  int width;
+  int height;
+  int tileSize;
+  double interval;
+
+  std::FILE *file = nullptr;
+  // Size of the valid part of the file read by load()
+  long validBytes = 0;
+
+  // Tiles finished since the last write
+  std::mutex pendingLock;
+  std::vector<Tile> pending;
+  std::mutex writeLock;
+  std::chrono::steady_clock::time_point lastWrite;
+
+  int tilesLoaded = 0;
+  int tilesWritten = 0;
+
+  void writeTiles(std::vector<Tile> const &tiles, Radiance const *radiance);
+
+public:
+  /**
+   * `interval`: seconds between two writes of the finished tiles.
+   */
+  Checkpoint(std::string path, uint64_t sceneHash, int width, int height, int tileSize, double interval);
+  ~Checkpoint();
+
+  /**
+   * Reads the tiles of an existing checkpoint into `radiance` (width x height)
+   * and marks them in `done` (indexed by grid index).
+   * Returns false, with `error` set, when the file is missing or was written for
+   * another scene, image size or tile size.
+   */
+  bool load(Radiance *radiance, std::vector<bool> &done, std::string &error);
+
+  /**
+   * Opens the file for writing: after the tiles read by load(), or from scratch.
+   */
+  bool open(bool keepLoadedTiles, std::string &error);
+
+  /**
+   * Called by a render thread when a tile is finished. Writes the pending
+   * tiles when the interval has elapsed (unless another thread is already writing).
+   */
+  void tileFinished(Tile const &tile, Radiance const *radiance);
+
+  // Writes all the pending tiles
+  void flush(Radiance const *radiance);
+
+  int getTilesLoaded() const { return tilesLoaded; };
+  int getTilesWritten() const { return tilesWritten; };
+};
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <vector>
+#include "../raymath/Vector3.hpp"
+#include "MaterialTable.hpp"
+
+/**
+ * Primary hit of every pixel of a rendered region: what the camera rays hit,
+ * kept to shade the image again (relighting) without tracing them again.
+ * Valid as long as the camera, the geometry and the region do not change.
+ */
+struct GBuffer
+{
+  int width = 0;
+  int height = 0;
+  std::vector<Vector3> position;
+  std::vector<Vector3> normal;
+  std::vector<Vector3> view;
+  // NO_MATERIAL when nothing is hit (or an object without material): black
+  std::vector<int> materialID;
+
+  void resize(int w, int h)
+  {
+    width = w;
+    height = h;
+    position.resize((size_t)w * h);
+    normal.resize((size_t)w * h);
+    view.resize((size_t)w * h);
+    materialID.assign((size_t)w * h, NO_MATERIAL);
+  }
+
+  void clear() { resize(0, 0); };
+  bool empty() const { return materialID.empty(); };
+};
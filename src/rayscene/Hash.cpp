@@ -0,0 +1,25 @@
+#include <cstdio>
+#include "Hash.hpp"
+
+uint64_t fnv1a(const void *data, size_t size, uint64_t hash)
+{
+  const unsigned char *bytes = (const unsigned char *)data;
+  for (size_t i = 0; i < size; ++i)
+  {
+    hash ^= bytes[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+uint64_t fnv1a(std::string const &data, uint64_t hash)
+{
+  return fnv1a(data.data(), data.size(), hash);
+}
+
+std::string hashToHex(uint64_t hash)
+{
+  char text[17];
+  std::snprintf(text, sizeof(text), "%016llx", (unsigned long long)hash);
+  return text;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+#define FNV1A_OFFSET 14695981039346656037ULL
+
+/**
+ * 64-bit FNV-1a hash. Pass the previous result as `hash` to hash data in several parts.
+ */
+uint64_t fnv1a(const void *data, size_t size, uint64_t hash = FNV1A_OFFSET);
+uint64_t fnv1a(std::string const &data, uint64_t hash = FNV1A_OFFSET);
+
+// 16 hexadecimal digits
+std::string hashToHex(uint64_t hash);
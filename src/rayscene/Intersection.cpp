@@ -3,7 +3,7 @@
 Intersection::Intersection() : Position(Vector3()),
                                Normal(Vector3()),
                                Distance(0),
-                               Mat(NULL)
+                               MaterialID(-1)
 {
 }
 
@@ -16,7 +16,7 @@ Intersection &Intersection::operator=(Intersection const &inter)
   Position = inter.Position;
   Normal = inter.Normal;
   Distance = inter.Distance;
-  Mat = inter.Mat;
+  MaterialID = inter.MaterialID;
   SourceRay = inter.SourceRay;
   View = inter.View;
   return *this;
@@ -4,8 +4,6 @@
 #include "../raymath/Color.hpp"
 #include "../raymath/Ray.hpp"
 
-class Material;
-
 class Intersection
 {
 public:
@@ -14,7 +12,8 @@ public:
   float Distance;
   Ray SourceRay;
   Vector3 View;
-  Material *Mat;
+  // Index of the material in the scene MaterialTable (NO_MATERIAL if none)
+  int MaterialID;
 
   Intersection();
   ~Intersection();
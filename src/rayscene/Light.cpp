@@ -15,3 +15,22 @@ Vector3 Light::GetPosition()
 {
   return center;
 }
+
+void Light::SetPosition(Vector3 const &c)
+{
+  center = c;
+}
+
+float Light::Attenuation(double distanceSquared) const
+{
+  if (Radius <= 0)
+  {
+    return 1;
+  }
+  double x = distanceSquared / (Radius * Radius);
+  if (x >= 1)
+  {
+    return 0;
+  }
+  return (1 - x) * (1 - x);
+}
@@ -15,6 +15,12 @@ public:
 
   Color Diffuse = Color(0.5, 0.5, 0.5);
   Color Specular = Color(1, 1, 1);
+  // Influence radius: the light fades out and does not reach beyond it (0 = no falloff)
+  double Radius = 0;
+
+  // Factor of the light at a squared distance: (1 - d²/r²)², 1 without radius
+  float Attenuation(double distanceSquared) const;
 
   Vector3 GetPosition();
+  void SetPosition(Vector3 const &c);
 };
@@ -0,0 +1,108 @@
+#include <cmath>
+#include <algorithm>
+#include "LightGrid.hpp"
+
+void LightGrid::build(std::vector<Light *> const &lights)
+{
+  unbounded.clear();
+  cellStart.clear();
+  cellLights.clear();
+
+  std::vector<int> bounded;
+  double radiusSum = 0;
+  Vector3 max;
+  for (size_t i = 0; i < lights.size(); ++i)
+  {
+    double r = lights[i]->Radius;
+    if (r <= 0)
+    {
+      unbounded.push_back(i);
+      continue;
+    }
+    Vector3 p = lights[i]->GetPosition();
+    Vector3 low = p - Vector3(r, r, r);
+    Vector3 high = p + Vector3(r, r, r);
+    min = bounded.empty() ? low : Vector3(std::min(min.x, low.x), std::min(min.y, low.y), std::min(min.z, low.z));
+    max = bounded.empty() ? high : Vector3(std::max(max.x, high.x), std::max(max.y, high.y), std::max(max.z, high.z));
+    radiusSum += r;
+    bounded.push_back(i);
+  }
+  if (bounded.empty())
+  {
+    return;
+  }
+
+  // Cells about the size of a light sphere, at most 64 along an axis
+  Vector3 extent = max - min;
+  double largest = std::max(extent.x, std::max(extent.y, extent.z));
+  cellSize = std::max(radiusSum / bounded.size(), largest / 64);
+  nx = std::max(1, (int)std::ceil(extent.x / cellSize));
+  ny = std::max(1, (int)std::ceil(extent.y / cellSize));
+  nz = std::max(1, (int)std::ceil(extent.z / cellSize));
+
+  // Calls f(cell) for each cell overlapped by the sphere of the light
+  auto forEachCell = [&](int light, auto f)
+  {
+    Vector3 p = lights[light]->GetPosition();
+    double r = lights[light]->Radius;
+    auto range = [&](double low, double high, double origin, int n, int &first, int &last)
+    {
+      first = std::clamp((int)std::floor((low - origin) / cellSize), 0, n - 1);
+      last = std::clamp((int)std::floor((high - origin) / cellSize), 0, n - 1);
+    };
+    int x0, x1, y0, y1, z0, z1;
+    range(p.x - r, p.x + r, min.x, nx, x0, x1);
+    range(p.y - r, p.y + r, min.y, ny, y0, y1);
+    range(p.z - r, p.z + r, min.z, nz, z0, z1);
+    for (int z = z0; z <= z1; ++z)
+    {
+      for (int y = y0; y <= y1; ++y)
+      {
+        for (int x = x0; x <= x1; ++x)
+        {
+          // Distance from the light to the box of the cell
+          Vector3 low = min + Vector3(x, y, z) * cellSize;
+          double dx = std::max(0.0, std::max(low.x - p.x, p.x - (low.x + cellSize)));
+          double dy = std::max(0.0, std::max(low.y - p.y, p.y - (low.y + cellSize)));
+          double dz = std::max(0.0, std::max(low.z - p.z, p.z - (low.z + cellSize)));
+          if (dx * dx + dy * dy + dz * dz <= r * r)
+          {
+            f((z * ny + y) * nx + x);
+          }
+        }
+      }
+    }
+  };
+
+  // Counted, then filled: the lights of each cell stay in scene order
+  cellStart.assign((size_t)nx * ny * nz + 1, 0);
+  for (int light : bounded)
+  {
+    forEachCell(light, [&](int c)
+                { cellStart[c + 1]++; });
+  }
+  for (size_t c = 1; c < cellStart.size(); ++c)
+  {
+    cellStart[c] += cellStart[c - 1];
+  }
+  cellLights.resize(cellStart.back());
+  std::vector<uint32_t> next(cellStart.begin(), cellStart.end() - 1);
+  for (int light : bounded)
+  {
+    forEachCell(light, [&](int c)
+                { cellLights[next[c]++] = light; });
+  }
+}
+
+int LightGrid::cell(Vector3 const &point) const
+{
+  // Compared before the conversion: a point can be far outside the grid
+  double x = std::floor((point.x - min.x) / cellSize);
+  double y = std::floor((point.y - min.y) / cellSize);
+  double z = std::floor((point.z - min.z) / cellSize);
+  if (!(x >= 0 && y >= 0 && z >= 0 && x < nx && y < ny && z < nz))
+  {
+    return -1;
+  }
+  return ((int)z * ny + (int)y) * nx + (int)x;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <vector>
+#include "../raymath/Vector3.hpp"
+#include "Light.hpp"
+
+/**
+ * Clustered light list: the lights with an influence radius binned into the
+ * cells of a uniform world grid, each cell listing the lights whose sphere of
+ * influence overlaps it. A point only looks at the lights of its cell (and at
+ * the lights without radius, which reach every point) instead of every light.
+ * A world grid rather than screen tiles: reflected rays hit points anywhere.
+ */
+class LightGrid
+{
+private:
+  // Lights without radius, in scene order
+  std::vector<int> unbounded;
+
+  // Grid over the spheres of the other lights: cells of `cellSize`, x fastest
+  Vector3 min;
+  double cellSize = 1;
+  int nx = 0;
+  int ny = 0;
+  int nz = 0;
+  // Lights of the cell c: cellLights[cellStart[c], cellStart[c + 1][, in scene order
+  std::vector<uint32_t> cellStart;
+  std::vector<int> cellLights;
+
+  // Cell of a point, -1 outside the grid
+  int cell(Vector3 const &point) const;
+
+public:
+  void build(std::vector<Light *> const &lights);
+  // Whether some lights have a radius (otherwise every light reaches every point)
+  bool empty() const { return cellStart.empty(); };
+
+  /**
+   * Calls f(index in the scene lights), in scene order, for the lights that
+   * may reach `point`: the lights without radius and the lights of its cell
+   * (which can still be too far: see Light::Attenuation).
+   */
+  template <typename F>
+  void forEach(Vector3 const &point, F f) const
+  {
+    // Both lists are sorted: merged, the lights come in scene order
+    size_t u = 0;
+    int c = cell(point);
+    if (c >= 0)
+    {
+      for (uint32_t i = cellStart[c]; i < cellStart[c + 1]; ++i)
+      {
+        while (u < unbounded.size() && unbounded[u] < cellLights[i])
+        {
+          f(unbounded[u++]);
+        }
+        f(cellLights[i]);
+      }
+    }
+    while (u < unbounded.size())
+    {
+      f(unbounded[u++]);
+    }
+  }
+};
@@ -0,0 +1,122 @@
+#include <algorithm>
+#include <numeric>
+#include "LightTree.hpp"
+
+float LightTree::power(Light *light)
+{
+  return (light->Diffuse.r + light->Diffuse.g + light->Diffuse.b + light->Specular.r + light->Specular.g + light->Specular.b) / 6;
+}
+
+void LightTree::build(std::vector<Light *> const &sceneLights)
+{
+  lights = sceneLights;
+  nodes.clear();
+  if (lights.empty())
+  {
+    return;
+  }
+  nodes.reserve(2 * lights.size());
+  std::vector<int> order(lights.size());
+  std::iota(order.begin(), order.end(), 0);
+  build(order, 0, order.size());
+}
+
+int LightTree::build(std::vector<int> &order, int begin, int end)
+{
+  const int index = nodes.size();
+  nodes.push_back(Node());
+
+  Node node;
+  node.min = lights[order[begin]]->GetPosition();
+  node.max = node.min;
+  for (int i = begin; i < end; ++i)
+  {
+    Vector3 p = lights[order[i]]->GetPosition();
+    node.min = Vector3(std::min(node.min.x, p.x), std::min(node.min.y, p.y), std::min(node.min.z, p.z));
+    node.max = Vector3(std::max(node.max.x, p.x), std::max(node.max.y, p.y), std::max(node.max.z, p.z));
+    // Dark lights still get a chance to be picked
+    node.power += std::max(power(lights[order[i]]), 1e-6f);
+    double radius = lights[order[i]]->Radius;
+    node.reach = std::max(node.reach, radius > 0 ? radius : std::numeric_limits<double>::infinity());
+  }
+
+  if (end - begin == 1)
+  {
+    node.light = order[begin];
+  }
+  else
+  {
+    // Median split along the largest extent of the box
+    Vector3 extent = node.max - node.min;
+    int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+    auto coordinate = [&](int light)
+    {
+      Vector3 p = lights[light]->GetPosition();
+      return axis == 0 ? p.x : (axis == 1 ? p.y : p.z);
+    };
+    int middle = (begin + end) / 2;
+    std::nth_element(order.begin() + begin, order.begin() + middle, order.begin() + end,
+                     [&](int a, int b)
+                     { return coordinate(a) < coordinate(b); });
+    node.left = build(order, begin, middle);
+    node.right = build(order, middle, end);
+  }
+  nodes[index] = node;
+  return index;
+}
+
+float LightTree::importance(Node const &node, Vector3 const &point) const
+{
+  Vector3 center = (node.min + node.max) / 2;
+  Vector3 extent = node.max - node.min;
+  if (node.reach < std::numeric_limits<double>::infinity())
+  {
+    // Distance from the point to the box
+    double dx = std::max(0.0, std::max(node.min.x - point.x, point.x - node.max.x));
+    double dy = std::max(0.0, std::max(node.min.y - point.y, point.y - node.max.y));
+    double dz = std::max(0.0, std::max(node.min.z - point.z, point.z - node.max.z));
+    if (dx * dx + dy * dy + dz * dz >= node.reach * node.reach)
+    {
+      return 0;
+    }
+  }
+  // Not closer than the size of the box: its lights can be anywhere in it
+  double distanceSquared = std::max((center - point).lengthSquared(), extent.lengthSquared() / 4);
+  return node.power / std::max(distanceSquared, 1e-6);
+}
+
+int LightTree::sample(Vector3 const &point, double u, float &probability) const
+{
+  probability = 1;
+  int index = 0;
+  if (importance(nodes[0], point) == 0)
+  {
+    return -1;
+  }
+  while (nodes[index].light < 0)
+  {
+    Node const &node = nodes[index];
+    float left = importance(nodes[node.left], point);
+    float right = importance(nodes[node.right], point);
+    if (left + right == 0)
+    {
+      return -1;
+    }
+    float pLeft = left / (left + right);
+    // Reuse the random number: rescaled to [0, 1[ in the chosen child
+    if (u < pLeft)
+    {
+      u = u / pLeft;
+      probability *= pLeft;
+      index = node.left;
+    }
+    else
+    {
+      u = (u - pLeft) / (1 - pLeft);
+      probability *= 1 - pLeft;
+      index = node.right;
+    }
+    u = std::min(u, 0.99999999);
+  }
+  return nodes[index].light;
+}
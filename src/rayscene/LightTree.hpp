@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vector>
+#include <limits>
+#include "../raymath/Vector3.hpp"
+#include "Light.hpp"
+
+/**
+ * Bounding volume hierarchy over the point lights of a scene, used to pick
+ * lights with a probability proportional to their estimated contribution to
+ * a point: from the root, each step goes down to one child with a
+ * probability proportional to its importance (power of its lights over the
+ * squared distance to them, 0 when they cannot reach it). Picking a light
+ * costs O(log n) instead of looking at every light.
+ */
+class LightTree
+{
+private:
+  struct Node
+  {
+    // Box around the lights of the node, and their total power
+    Vector3 min;
+    Vector3 max;
+    float power = 0;
+    // Largest influence radius of its lights (infinite when one has none)
+    double reach = 0;
+    // Children (inner node), or index of the light in the scene (leaf)
+    int left = -1;
+    int right = -1;
+    int light = -1;
+  };
+
+  std::vector<Node> nodes;
+  std::vector<Light *> lights;
+
+  // Builds the node of lights[begin, end[ (reordered in `order`) and returns its index
+  int build(std::vector<int> &order, int begin, int end);
+  float importance(Node const &node, Vector3 const &point) const;
+
+public:
+  void build(std::vector<Light *> const &sceneLights);
+  bool empty() const { return nodes.empty(); };
+
+  /**
+   * Picks a light for the point with the random number u in [0, 1[.
+   * Returns its index in the scene lights, and sets `probability` to the
+   * probability of picking it, or -1 when no light can reach the point.
+   */
+  int sample(Vector3 const &point, double u, float &probability) const;
+
+  // Estimated power of a light: mean of its diffuse and specular colors
+  static float power(Light *light);
+};
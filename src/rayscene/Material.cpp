@@ -1,7 +1,9 @@
 #include <iostream>
+#include <sstream>
 #include "Material.hpp"
 #include "Intersection.hpp"
 #include "Scene.hpp"
+#include "Wavefront.hpp"
 
 Material::Material() : cReflection(0)
 {
@@ -11,8 +13,36 @@ Material::~Material()
 {
 }
 
-Color Material::render(Ray &r, Ray &camera, Intersection *intersection, Scene *scene)
+Radiance Material::render(Ray &r, Ray &camera, Intersection *intersection, Scene *scene)
 {
-  Color black;
+  Radiance black;
   return black;
-}
\ No newline at end of file
+}
+
+void Material::shadowRays(Intersection *intersection, Scene *scene, RayQueue &rays, int hit)
+{
+}
+
+Radiance Material::render(Ray &r, Ray &camera, Intersection *intersection, Scene *scene, const char *blocked)
+{
+  return render(r, camera, intersection, scene);
+}
+
+void Material::renderBatch(ShadingBatch const &batch)
+{
+  for (uint32_t h : batch.indices)
+  {
+    Intersection hit = batch.hits->get(h);
+    const int ray = batch.hits->ray[h];
+    Ray r = batch.rays->get(ray);
+    Ray camera = batch.cameraRays->get(batch.rays->owner[ray]);
+    batch.radiance[h] = render(r, camera, &hit, batch.scene, batch.blocked + batch.firstShadow[h]);
+  }
+}
+
+std::string Material::signature() const
+{
+  std::ostringstream stream;
+  stream << std::hexfloat << "material:" << cReflection;
+  return stream.str();
+}
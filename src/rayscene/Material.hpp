@@ -1,9 +1,13 @@
 #pragma once
+#include <string>
 #include "../raymath/Ray.hpp"
 #include "../raymath/Color.hpp"
+#include "../raymath/Radiance.hpp"
 
 class Scene;
 class Intersection;
+struct RayQueue;
+struct ShadingBatch;
 
 class Material
 {
@@ -12,6 +16,22 @@ public:
   float cReflection = 0;
 
   Material();
-  ~Material();
-  virtual Color render(Ray &r, Ray &camera, Intersection *intersection, Scene *scene);
+  virtual ~Material();
+  virtual Radiance render(Ray &r, Ray &camera, Intersection *intersection, Scene *scene);
+
+  /**
+   * Wavefront shading, in two stages: the shadow rays render() traces (any hit,
+   * back faces culled) are appended to `rays`, then render() is called with
+   * whether each of them is blocked. Same radiance as render().
+   */
+  virtual void shadowRays(Intersection *intersection, Scene *scene, RayQueue &rays, int hit);
+  virtual Radiance render(Ray &r, Ray &camera, Intersection *intersection, Scene *scene, const char *blocked);
+  // Deferred shading: render() for all the hits of a batch (by default one call per hit)
+  virtual void renderBatch(ShadingBatch const &batch);
+
+  /**
+   * Describes the content of the material: two materials with the same
+   * signature render identically (used to deduplicate materials).
+   */
+  virtual std::string signature() const;
 };
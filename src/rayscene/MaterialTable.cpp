@@ -0,0 +1,58 @@
+#include <iostream>
+#include "MaterialTable.hpp"
+
+MaterialTable::MaterialTable()
+{
+}
+
+MaterialTable::~MaterialTable()
+{
+  for (int i = 0; i < materials.size(); ++i)
+  {
+    delete materials[i];
+  }
+}
+
+int MaterialTable::intern(Material *material)
+{
+  std::string signature = material->signature();
+
+  auto found = bySignature.find(signature);
+  if (found != bySignature.end())
+  {
+    delete material;
+    return found->second;
+  }
+
+  int id = materials.size();
+  materials.push_back(material);
+  bySignature[signature] = id;
+  return id;
+}
+
+int MaterialTable::add(Material *material)
+{
+  materials.push_back(material);
+  return materials.size() - 1;
+}
+
+void MaterialTable::replace(int id, Material *material)
+{
+  delete materials[id];
+  materials[id] = material;
+}
+
+void MaterialTable::setName(std::string const &name, int id)
+{
+  byName[name] = id;
+}
+
+int MaterialTable::find(std::string const &name) const
+{
+  auto found = byName.find(name);
+  if (found == byName.end())
+  {
+    return NO_MATERIAL;
+  }
+  return found->second;
+}
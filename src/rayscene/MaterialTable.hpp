@@ -0,0 +1,48 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "Material.hpp"
+
+#define NO_MATERIAL -1
+
+/**
+ * Flat table of the materials of a scene.
+ * Inline materials are deduplicated by content, named materials keep their own
+ * ID (so that editing one does not change the others); objects and hit records
+ * only carry the small integer ID of their material.
+ * The table owns the materials.
+ */
+class MaterialTable
+{
+private:
+  std::vector<Material *> materials;
+  std::unordered_map<std::string, int> bySignature;
+  std::unordered_map<std::string, int> byName;
+
+public:
+  MaterialTable();
+  ~MaterialTable();
+
+  /**
+   * Adds a material to the table and returns its ID.
+   * If an identical material is already present, the new one is deleted
+   * and the ID of the existing one is returned.
+   */
+  int intern(Material *material);
+  // Adds a material with an ID of its own, never shared with an identical one
+  int add(Material *material);
+
+  /**
+   * Puts `material` in place of the material `id` (deleted), added with add():
+   * only the objects using this ID now use the new material.
+   */
+  void replace(int id, Material *material);
+
+  void setName(std::string const &name, int id);
+  // Returns NO_MATERIAL if the name is unknown
+  int find(std::string const &name) const;
+
+  Material *get(int id) const { return materials[id]; };
+  size_t size() const { return materials.size(); };
+};
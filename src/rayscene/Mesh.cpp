@@ -3,6 +3,7 @@
 #include "Mesh.hpp"
 #include "../raymath/Vector3.hpp"
 #include "../objloader/OBJ_Loader.h"
+#include "../raythread/ThreadPool.hpp"
 
 Mesh::Mesh() : SceneObject()
 {
@@ -54,19 +55,19 @@ void Mesh::loadFromObj(std::string path)
         }
     }
 
-    this->applyTransform();
+    // Triangles are transformed by Scene::prepare, once the scene settings are known
     delete loader;
 }
 
 void Mesh::applyTransform()
 {
-    for (int i = 0; i < triangles.size(); ++i)
-    {
-        triangles[i]->material = this->material;
+    // Triangles are independent: transformed by the shared worker pool
+    ThreadPool::shared()->parallelFor(0, triangles.size(), 64, [&](int i)
+                                     {
+        triangles[i]->materialID = this->materialID;
         triangles[i]->transform = transform;
         triangles[i]->applyTransform();
-        triangles[i]->calculateBoundingBox();
-    }
+        triangles[i]->calculateBoundingBox(); });
 }
 
 void Mesh::calculateBoundingBox()
@@ -87,6 +88,34 @@ void Mesh::calculateBoundingBox()
 }
 
 bool Mesh::intersects(Ray &r, Intersection &intersection, CullingType culling)
+{
+    switch (culling)
+    {
+    case CULLING_FRONT:
+        return traverse<CULLING_FRONT, false>(r, intersection);
+    case CULLING_BACK:
+        return traverse<CULLING_BACK, false>(r, intersection);
+    default:
+        return traverse<CULLING_BOTH, false>(r, intersection);
+    }
+}
+
+bool Mesh::occludes(Ray &r, CullingType culling)
+{
+    Intersection unused;
+    switch (culling)
+    {
+    case CULLING_FRONT:
+        return traverse<CULLING_FRONT, true>(r, unused);
+    case CULLING_BACK:
+        return traverse<CULLING_BACK, true>(r, unused);
+    default:
+        return traverse<CULLING_BOTH, true>(r, unused);
+    }
+}
+
+template <CullingType culling, bool anyHit>
+bool Mesh::traverse(Ray &r, Intersection &intersection)
 {
     Intersection tInter;
 
@@ -98,8 +127,14 @@ bool Mesh::intersects(Ray &r, Intersection &intersection, CullingType culling)
 
     for (size_t i = 0; i < triangleCount; ++i)
     {
-        if (triangles[i]->intersects(r, tInter, culling))
+        if (triangles[i]->intersectsCulled<culling>(r, tInter))
         {
+            // Any-hit query: the first hit is enough
+            if (anyHit)
+            {
+                return true;
+            }
+
             // Optimisation : lenghth au lieu de lengthSquared
             double distanceSquared = (tInter.Position - r.GetPosition()).lengthSquared();
             // tInter.Distance = (tInter.Position - r.GetPosition()).length();
@@ -125,4 +160,4 @@ bool Mesh::intersects(Ray &r, Intersection &intersection, CullingType culling)
 
     intersection = closestInter;
     return true;
-}
\ No newline at end of file
+}
@@ -12,6 +12,13 @@ class Mesh : public SceneObject
 private:
   std::vector<Triangle *> triangles;
 
+  /**
+   * Triangle loop specialised on the culling mode and on the kind of query:
+   * closest hit (camera/reflection rays) or any hit (shadow rays).
+   */
+  template <CullingType culling, bool anyHit>
+  bool traverse(Ray &r, Intersection &intersection);
+
 public:
   Mesh();
   ~Mesh();
@@ -21,4 +28,5 @@ public:
   virtual void applyTransform() override;
   virtual void calculateBoundingBox() override;
   virtual bool intersects(Ray &r, Intersection &intersection, CullingType culling) override;
+  virtual bool occludes(Ray &r, CullingType culling) override;
 };
@@ -0,0 +1,165 @@
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include "PartialRender.hpp"
+#include "TileScheduler.hpp"
+#include "Hash.hpp"
+
+#define PARTIAL_MAGIC "RTPART01"
+
+struct PartialHeader
+{
+  char magic[8];
+  uint64_t sceneHash;
+  int32_t width;
+  int32_t height;
+  int32_t tileSize;
+  int32_t tileCount;
+};
+
+bool PartialRender::write(std::string const &path, uint64_t sceneHash, Image &image, int imageX0, int imageY0,
+                          int width, int height, int tileSize, TileSubset const &tiles, std::string &error)
+{
+  const int gridTiles = TileScheduler::gridTileCount(width, height, tileSize);
+  PartialHeader header = {};
+  std::memcpy(header.magic, PARTIAL_MAGIC, 8);
+  header.sceneHash = sceneHash;
+  header.width = width;
+  header.height = height;
+  header.tileSize = tileSize;
+  for (int i = 0; i < gridTiles; ++i)
+  {
+    header.tileCount += tiles.contains(i);
+  }
+
+  std::FILE *file = std::fopen(path.c_str(), "wb");
+  if (file == nullptr)
+  {
+    error = "cannot write partial render " + path;
+    return false;
+  }
+  std::fwrite(&header, sizeof(header), 1, file);
+
+  std::vector<unsigned char> pixels;
+  for (int i = 0; i < gridTiles; ++i)
+  {
+    if (!tiles.contains(i))
+    {
+      continue;
+    }
+
+    Tile tile = TileScheduler::gridTile(width, height, tileSize, i);
+    pixels.clear();
+    for (int y = tile.y0; y < tile.y1; ++y)
+    {
+      for (int x = tile.x0; x < tile.x1; ++x)
+      {
+        // Same conversion as Image::writeFile
+        Color pixel = image.getPixel(imageX0 + x, imageY0 + y);
+        pixels.push_back((unsigned int)std::floor(pixel.r * 255));
+        pixels.push_back((unsigned int)std::floor(pixel.g * 255));
+        pixels.push_back((unsigned int)std::floor(pixel.b * 255));
+      }
+    }
+
+    int32_t index = i;
+    std::fwrite(&index, sizeof(index), 1, file);
+    std::fwrite(pixels.data(), 1, pixels.size(), file);
+  }
+
+  bool ok = std::ferror(file) == 0;
+  ok = std::fclose(file) == 0 && ok;
+  if (!ok)
+  {
+    error = "cannot write partial render " + path;
+  }
+  return ok;
+}
+
+Image *PartialRender::merge(std::vector<std::string> const &paths, std::string &error, TileSubset const &tiles)
+{
+  Image *image = nullptr;
+  PartialHeader first = {};
+  std::vector<bool> done;
+  std::vector<unsigned char> pixels;
+
+  for (std::string const &path : paths)
+  {
+    std::FILE *file = std::fopen(path.c_str(), "rb");
+    PartialHeader header;
+    if (file == nullptr || std::fread(&header, sizeof(header), 1, file) != 1 ||
+        std::memcmp(header.magic, PARTIAL_MAGIC, 8) != 0)
+    {
+      error = path + " is not a partial render";
+    }
+    else if (image == nullptr)
+    {
+      first = header;
+      image = new Image(header.width, header.height);
+      done.assign(TileScheduler::gridTileCount(header.width, header.height, header.tileSize), false);
+    }
+    else if (header.sceneHash != first.sceneHash || header.width != first.width ||
+             header.height != first.height || header.tileSize != first.tileSize)
+    {
+      error = path + " is a part of another render (scene hash " + hashToHex(header.sceneHash) + ", expected " +
+              hashToHex(first.sceneHash) + ")";
+    }
+
+    for (int t = 0; error.empty() && t < header.tileCount; ++t)
+    {
+      int32_t index;
+      if (std::fread(&index, sizeof(index), 1, file) != 1 || index < 0 || index >= (int)done.size())
+      {
+        error = path + " is truncated or corrupted";
+        break;
+      }
+      if (!tiles.contains(index))
+      {
+        error = path + " has tile " + std::to_string(index) + ", not one of the tiles to render";
+        break;
+      }
+      Tile tile = TileScheduler::gridTile(header.width, header.height, header.tileSize, index);
+      pixels.resize((size_t)(tile.x1 - tile.x0) * (tile.y1 - tile.y0) * 3);
+      if (std::fread(pixels.data(), 1, pixels.size(), file) != pixels.size())
+      {
+        error = path + " is truncated or corrupted";
+        break;
+      }
+
+      // Middle of each 8-bit interval: writeFile gives back the same bytes
+      size_t offset = 0;
+      for (int y = tile.y0; y < tile.y1; ++y)
+      {
+        for (int x = tile.x0; x < tile.x1; ++x, offset += 3)
+        {
+          image->setPixel(x, y, Color((pixels[offset] + 0.5) / 255.0, (pixels[offset + 1] + 0.5) / 255.0,
+                                      (pixels[offset + 2] + 0.5) / 255.0));
+        }
+      }
+      done[index] = true;
+    }
+
+    if (file != nullptr)
+    {
+      std::fclose(file);
+    }
+    if (!error.empty())
+    {
+      delete image;
+      return nullptr;
+    }
+  }
+
+  int missing = 0;
+  for (size_t i = 0; i < done.size(); ++i)
+  {
+    missing += !done[i] && tiles.contains(i);
+  }
+  if (image == nullptr || missing > 0)
+  {
+    error = image == nullptr ? "no partial render to merge" : std::to_string(missing) + " tiles are missing";
+    delete image;
+    return nullptr;
+  }
+  return image;
+}
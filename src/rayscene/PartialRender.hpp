@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "../rayimage/Image.hpp"
+#include "RenderSettings.hpp"
+
+/**
+ * Result of a process that rendered only a subset of the tiles of a frame
+ * (distributed rendering), to be merged with the other parts into the image.
+ *
+ * Raw format: a header (scene hash, image and tile size) followed, for each
+ * rendered tile, by its grid index and its 8-bit RGB pixels, row by row.
+ */
+class PartialRender
+{
+public:
+  /**
+   * Writes the tiles of `tiles` of a width x height image, whose pixels are
+   * at (imageX0, imageY0) in `image`.
+   */
+  static bool write(std::string const &path, uint64_t sceneHash, Image &image, int imageX0, int imageY0,
+                    int width, int height, int tileSize, TileSubset const &tiles, std::string &error);
+
+  /**
+   * Assembles partial renders of the same scene into a new image (black
+   * outside the tiles of `tiles`).
+   * Returns nullptr, with `error` set, if they do not match, or a tile of `tiles`
+   * is missing or another tile is present.
+   */
+  static Image *merge(std::vector<std::string> const &paths, std::string &error,
+                      TileSubset const &tiles = TileSubset());
+};
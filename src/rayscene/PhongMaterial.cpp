@@ -1,9 +1,11 @@
 #include <iostream>
 #include <cmath>
+#include <sstream>
 #include "PhongMaterial.hpp"
 #include "Intersection.hpp"
 #include "Light.hpp"
 #include "Scene.hpp"
+#include "Wavefront.hpp"
 #include "Intersection.hpp"
 
 PhongMaterial::PhongMaterial()
@@ -19,42 +21,171 @@ Color PhongMaterial::getAmbient(Intersection *intersection)
   return Ambient;
 }
 
-Color PhongMaterial::render(Ray &r, Ray &camera, Intersection *intersection, Scene *scene)
+std::string PhongMaterial::signature() const
 {
+  // hexfloat: exact representation, only bit-identical materials are merged
+  std::ostringstream stream;
+  stream << std::hexfloat << "phong:" << Ambient << Diffuse << Specular << Shininess << ":" << cReflection;
+  return stream.str();
+}
 
-  Color color = getAmbient(intersection) * scene->globalAmbient;
+template <typename Visible>
+Radiance PhongMaterial::lighting(Intersection *intersection, Scene *scene, Visible visible)
+{
 
-  // std::vector<Light *> lights = scene->getLights();
-  // optimization : get reference to avoid copy
-  const std::vector<Light *> &lights = scene->getLights();
-  // optimization: precompute size or cach size
-  const size_t lightCount = lights.size();
-  for (size_t i = 0; i < lightCount; ++i)
-  {
-    Light *light = lights[i];
+  // Accumulated unclamped, the pixel is clamped once when written to the image
+  Radiance color = Radiance(getAmbient(intersection)) * Radiance(scene->globalAmbient);
 
+  // Adds the i-th light used, its contribution scaled by weight
+  auto addLight = [&](size_t i, Light *light, float weight)
+  {
     Vector3 lightDir = (light->GetPosition() - intersection->Position).normalize();
 
     Vector3 origin = intersection->Position + lightDir;
     Ray lightRay(origin, lightDir);
-    Intersection shadowInter;
-    if (!scene->closestIntersection(lightRay, shadowInter, CULLING_BACK))
+    if (visible(i, lightRay))
     {
 
       float dotProdLN = lightDir.dot(intersection->Normal);
       if (dotProdLN > 0)
       {
-        color = color + (light->Diffuse * Diffuse * dotProdLN);
+        color = color + (Radiance(light->Diffuse) * Radiance(Diffuse) * dotProdLN) * weight;
       }
 
       Vector3 R = (lightDir * -1).reflect(intersection->Normal);
       float dotProdRV = R.dot(intersection->View);
       if (dotProdRV > 0)
       {
-        color = color + (light->Specular * Specular * pow(dotProdRV, Shininess));
+        color = color + (Radiance(light->Specular) * Radiance(Specular) * pow(dotProdRV, Shininess)) * weight;
       }
     }
+  };
+
+  // Many lights: a few of them picked from the light tree, or the ones within reach
+  if (scene->selectsLights())
+  {
+    thread_local std::vector<LightSample> selection;
+    scene->selectLights(intersection->Position, selection);
+    for (size_t i = 0; i < selection.size(); ++i)
+    {
+      addLight(i, selection[i].light, selection[i].weight);
+    }
+    return color;
+  }
+
+  // std::vector<Light *> lights = scene->getLights();
+  // optimization : get reference to avoid copy
+  const std::vector<Light *> &lights = scene->getLights();
+  // optimization: precompute size or cach size
+  const size_t lightCount = lights.size();
+  for (size_t i = 0; i < lightCount; ++i)
+  {
+    addLight(i, lights[i], 1);
   }
 
   return color;
-}
\ No newline at end of file
+}
+
+Radiance PhongMaterial::render(Ray &r, Ray &camera, Intersection *intersection, Scene *scene)
+{
+  // optimization : any-hit query, the closest occluder is not needed
+  return lighting(intersection, scene, [scene](size_t, Ray &lightRay)
+                  { return !scene->anyIntersection(lightRay, CULLING_BACK); });
+}
+
+void PhongMaterial::shadowRays(Intersection *intersection, Scene *scene, RayQueue &rays, int hit)
+{
+  // The same rays as lighting(), one per light used
+  auto addRay = [&](Light *light)
+  {
+    Vector3 lightDir = (light->GetPosition() - intersection->Position).normalize();
+    rays.push(Ray(intersection->Position + lightDir, lightDir), hit);
+  };
+
+  if (scene->selectsLights())
+  {
+    thread_local std::vector<LightSample> selection;
+    scene->selectLights(intersection->Position, selection);
+    for (LightSample const &sample : selection)
+    {
+      addRay(sample.light);
+    }
+    return;
+  }
+  for (Light *light : scene->getLights())
+  {
+    addRay(light);
+  }
+}
+
+Radiance PhongMaterial::render(Ray &r, Ray &camera, Intersection *intersection, Scene *scene, const char *blocked)
+{
+  return lighting(intersection, scene, [blocked](size_t i, Ray &)
+                  { return !blocked[i]; });
+}
+
+void PhongMaterial::getAmbients(ShadingBatch const &batch, Color *ambients)
+{
+  for (size_t i = 0; i < batch.indices.size(); ++i)
+  {
+    ambients[i] = Ambient;
+  }
+}
+
+void PhongMaterial::renderBatch(ShadingBatch const &batch)
+{
+  // Each hit has its own lights: shaded one by one
+  if (batch.scene->selectsLights())
+  {
+    Material::renderBatch(batch);
+    return;
+  }
+
+  thread_local std::vector<Color> ambients;
+  HitQueue const &hits = *batch.hits;
+  const size_t count = batch.indices.size();
+  ambients.resize(count);
+  getAmbients(batch, ambients.data());
+
+  for (size_t i = 0; i < count; ++i)
+  {
+    batch.radiance[batch.indices[i]] = Radiance(ambients[i]) * Radiance(batch.scene->globalAmbient);
+  }
+
+  // Light by light: each hit still adds the lights in the order of lighting()
+  const std::vector<Light *> &lights = batch.scene->getLights();
+  for (size_t l = 0; l < lights.size(); ++l)
+  {
+    Light *light = lights[l];
+    const Vector3 lightPosition = light->GetPosition();
+    const Radiance diffuse = Radiance(light->Diffuse) * Radiance(Diffuse);
+    const Radiance specular = Radiance(light->Specular) * Radiance(Specular);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+      const uint32_t h = batch.indices[i];
+      if (batch.blocked[batch.firstShadow[h] + l])
+      {
+        continue;
+      }
+      Vector3 position(hits.px[h], hits.py[h], hits.pz[h]);
+      Vector3 normal(hits.nx[h], hits.ny[h], hits.nz[h]);
+      Vector3 view(hits.vx[h], hits.vy[h], hits.vz[h]);
+      Radiance &color = batch.radiance[h];
+
+      Vector3 lightDir = (lightPosition - position).normalize();
+      float dotProdLN = lightDir.dot(normal);
+      if (dotProdLN > 0)
+      {
+        color = color + diffuse * dotProdLN;
+      }
+
+      Vector3 R = (lightDir * -1).reflect(normal);
+      float dotProdRV = R.dot(view);
+      if (dotProdRV > 0)
+      {
+        color = color + specular * pow(dotProdRV, Shininess);
+      }
+    }
+  }
+}
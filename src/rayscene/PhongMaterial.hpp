@@ -13,6 +13,17 @@ class Intersection;
 class PhongMaterial : public Material
 {
 private:
+  /**
+   * Ambient, diffuse and specular terms. `visible(i, lightRay)` tells whether
+   * the i-th light is seen through its shadow ray.
+   */
+  template <typename Visible>
+  Radiance lighting(Intersection *intersection, Scene *scene, Visible visible);
+
+protected:
+  // getAmbient() of each hit of a batch, in the order of batch.indices
+  virtual void getAmbients(ShadingBatch const &batch, Color *ambients);
+
 public:
   Color Ambient;
   Color Diffuse = Color(1, 1, 1);
@@ -21,6 +32,11 @@ public:
 
   PhongMaterial();
   ~PhongMaterial();
-  virtual Color render(Ray &r, Ray &camera, Intersection *intersection, Scene *scene) override;
+  virtual Radiance render(Ray &r, Ray &camera, Intersection *intersection, Scene *scene) override;
+  virtual void shadowRays(Intersection *intersection, Scene *scene, RayQueue &rays, int hit) override;
+  virtual Radiance render(Ray &r, Ray &camera, Intersection *intersection, Scene *scene, const char *blocked) override;
+  // lighting() over the whole batch, light by light
+  virtual void renderBatch(ShadingBatch const &batch) override;
   virtual Color getAmbient(Intersection *intersection);
+  virtual std::string signature() const override;
 };
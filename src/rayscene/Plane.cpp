@@ -37,7 +37,7 @@ bool Plane::intersects(Ray &r, Intersection &intersection, CullingType culling)
 
   intersection.Position = r.GetPosition() + (r.GetDirection() * t);
   intersection.Normal = normal;
-  intersection.Mat = this->material;
+  intersection.MaterialID = this->materialID;
 
   return true;
 }
\ No newline at end of file
@@ -14,6 +14,9 @@ public:
   Plane(Vector3 p, Vector3 n);
   ~Plane();
 
+  const Vector3 &getPoint() const { return point; };
+  const Vector3 &getNormal() const { return normal; };
+
   virtual void calculateBoundingBox() override;
   virtual bool intersects(Ray &r, Intersection &intersection, CullingType culling) override;
 };
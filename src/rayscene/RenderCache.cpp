@@ -0,0 +1,134 @@
+#include <fstream>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <unistd.h>
+#include "RenderCache.hpp"
+#include "Hash.hpp"
+
+// Changed when the renderer output changes: images of older versions are not reused
+#define RENDER_CACHE_FORMAT "raytracer-render-cache-1"
+#define RENDER_CACHE_COUNTERS "counters"
+
+namespace fs = std::filesystem;
+
+RenderCache::RenderCache(fs::path directory, uint64_t maxBytes) : directory(directory), maxBytes(maxBytes)
+{
+  std::error_code ec;
+  fs::create_directories(directory, ec);
+  loadCounters();
+}
+
+fs::path RenderCache::entryPath(uint64_t contentHash) const
+{
+  uint64_t key = fnv1a(&contentHash, sizeof(contentHash), fnv1a(RENDER_CACHE_FORMAT));
+  return directory / (hashToHex(key) + ".png");
+}
+
+void RenderCache::loadCounters()
+{
+  std::ifstream in(directory / RENDER_CACHE_COUNTERS);
+  in >> hits >> misses;
+  if (!in)
+  {
+    hits = 0;
+    misses = 0;
+  }
+}
+
+void RenderCache::saveCounters() const
+{
+  std::ofstream out(directory / RENDER_CACHE_COUNTERS);
+  out << hits << " " << misses << std::endl;
+}
+
+bool RenderCache::fetch(uint64_t contentHash, std::string const &outputPath)
+{
+  fs::path entry = entryPath(contentHash);
+  std::error_code ec;
+  bool hit = fs::exists(entry, ec) &&
+             fs::copy_file(entry, outputPath, fs::copy_options::overwrite_existing, ec);
+  if (hit)
+  {
+    // Most recently used
+    fs::last_write_time(entry, fs::file_time_type::clock::now(), ec);
+    hits++;
+  }
+  else
+  {
+    misses++;
+  }
+  saveCounters();
+  return hit;
+}
+
+void RenderCache::store(uint64_t contentHash, std::string const &imagePath)
+{
+  fs::path entry = entryPath(contentHash);
+  // Copy then rename: another process never sees a partial image
+  fs::path temporary = entry;
+  temporary += ".tmp" + std::to_string(getpid());
+
+  std::error_code ec;
+  if (fs::copy_file(imagePath, temporary, fs::copy_options::overwrite_existing, ec))
+  {
+    fs::rename(temporary, entry, ec);
+  }
+  if (ec)
+  {
+    fs::remove(temporary, ec);
+    return;
+  }
+  evict();
+}
+
+void RenderCache::evict()
+{
+  struct Entry
+  {
+    fs::path path;
+    fs::file_time_type used;
+    uint64_t size;
+  };
+  std::vector<Entry> entries;
+  uint64_t total = 0;
+
+  std::error_code ec;
+  for (auto const &file : fs::directory_iterator(directory, ec))
+  {
+    if (file.path().extension() == ".png")
+    {
+      entries.push_back({file.path(), file.last_write_time(ec), file.file_size(ec)});
+      total += entries.back().size;
+    }
+  }
+
+  std::sort(entries.begin(), entries.end(), [](Entry const &a, Entry const &b)
+            { return a.used < b.used; });
+  for (size_t i = 0; i < entries.size() && total > maxBytes; ++i)
+  {
+    fs::remove(entries[i].path, ec);
+    total -= entries[i].size;
+  }
+}
+
+void RenderCache::printStats(std::ostream &_stream) const
+{
+  int images = 0;
+  uint64_t total = 0;
+  std::error_code ec;
+  for (auto const &file : fs::directory_iterator(directory, ec))
+  {
+    if (file.path().extension() == ".png")
+    {
+      images++;
+      total += file.file_size(ec);
+    }
+  }
+
+  char line[160];
+  long lookups = hits + misses;
+  std::snprintf(line, sizeof(line), "Render cache: %ld hits, %ld misses (%.1f%% hit rate), %d images, %.1f of %.1f MB",
+                hits, misses, lookups > 0 ? 100.0 * hits / lookups : 0.0, images, total / 1048576.0, maxBytes / 1048576.0);
+  _stream << line << std::endl;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <iostream>
+#include <filesystem>
+
+/**
+ * On-disk cache of finished images, addressed by the hash of what is rendered
+ * (Scene::contentHash: canonical scene JSON, OBJ contents, resolution and the
+ * render options changing the pixels). A job identical to a previous one
+ * copies the cached PNG instead of rendering.
+ *
+ * The cache directory is bounded in size: the least recently used images
+ * (by modification time, refreshed on each hit) are deleted beyond maxBytes.
+ * The hit and miss counters are kept in the directory, across processes.
+ */
+class RenderCache
+{
+private:
+  std::filesystem::path directory;
+  uint64_t maxBytes;
+  long hits = 0;
+  long misses = 0;
+
+  std::filesystem::path entryPath(uint64_t contentHash) const;
+  void loadCounters();
+  void saveCounters() const;
+  void evict();
+
+public:
+  RenderCache(std::filesystem::path directory, uint64_t maxBytes);
+
+  // Copies the cached image to outputPath. Returns false on a miss.
+  bool fetch(uint64_t contentHash, std::string const &outputPath);
+  // Adds a rendered image (copied), then evicts beyond the size limit
+  void store(uint64_t contentHash, std::string const &imagePath);
+
+  long getHits() const { return hits; };
+  long getMisses() const { return misses; };
+
+  // Hits, misses, and size of the cache
+  void printStats(std::ostream &_stream) const;
+};
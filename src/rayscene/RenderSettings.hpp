@@ -0,0 +1,102 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "TileScheduler.hpp"
+
+enum AntialiasingMode
+{
+  AA_NONE,    // One ray per pixel
+  AA_ADAPTIVE // Extra samples only where the image has contrast
+};
+
+// How the rays of a tile are traced (the image is the same)
+enum Integrator
+{
+  INTEGRATOR_RECURSIVE, // One pixel at a time, Scene::raycast
+  INTEGRATOR_WAVEFRONT  // All the pixels of the tile together, stage by stage
+};
+
+// Weight of a sample as a function of its distance to the pixel center
+enum ReconstructionFilter
+{
+  FILTER_BOX,
+  FILTER_TENT,
+  FILTER_GAUSSIAN
+};
+
+struct AntialiasingSettings
+{
+  AntialiasingMode mode = AA_NONE;
+  // Number of samples of a refined pixel: at least minSamples, at most maxSamples
+  int minSamples = 4;
+  int maxSamples = 16;
+  // A pixel is refined when it differs from a neighbour by more than this (max over r, g, b);
+  // its refinement stops once the standard error of its samples is below half of it
+  float threshold = 0.05;
+  ReconstructionFilter filter = FILTER_TENT;
+};
+
+/**
+ * Rectangle of the frame to render, in pixels (width or height 0 = the whole frame).
+ * The camera mapping is the one of the whole frame.
+ */
+struct RenderRegion
+{
+  int x = 0;
+  int y = 0;
+  int width = 0;
+  int height = 0;
+  // The output image only holds the region, instead of the whole frame
+  bool crop = false;
+};
+
+/**
+ * Tiles rendered by this process, by row-major grid index: begin, begin + step, ...
+ * up to end (excluded). Used to split a frame between processes or machines.
+ */
+struct TileSubset
+{
+  int begin = 0;
+  int end = -1; // -1 = up to the last tile
+  int step = 1;
+  // Tiles to render by grid index, on top of the range (empty = no restriction)
+  std::vector<bool> mask;
+
+  bool all() const { return begin <= 0 && end < 0 && step <= 1 && mask.empty(); };
+  bool contains(int index) const
+  {
+    return index >= begin && (end < 0 || index < end) && (index - begin) % std::max(step, 1) == 0 &&
+           (mask.empty() || (index < (int)mask.size() && mask[index]));
+  };
+};
+
+/**
+ * Options controlling how a frame is rendered (not what is rendered).
+ * Read from the "render" section of the scene file, and can be overridden
+ * from the command line.
+ */
+struct RenderSettings
+{
+  // Number of render threads, 0 = automatic (CPU quota / affinity mask of the process)
+  int threads = 0;
+  // Pin each worker thread to its own core
+  bool pinThreads = false;
+  // Size in pixels of the square tiles handed out to the render threads
+  int tileSize = 32;
+  // Order in which the tiles are rendered
+  TileOrder tileOrder = TILE_ORDER_HILBERT;
+  Integrator integrator = INTEGRATOR_RECURSIVE;
+  // Wavefront integrator: reorder the reflected rays by origin and direction before tracing them
+  bool sortRays = false;
+  AntialiasingSettings antialiasing;
+  // Progressive rendering: wall-clock budget in seconds (0 = render everything)
+  double timeBudget = 0;
+  RenderRegion region;
+  TileSubset tiles;
+  // File where the finished tiles are saved every checkpointInterval seconds ("" = none)
+  std::string checkpoint;
+  double checkpointInterval = 30;
+  // Only render the tiles missing from the checkpoint file
+  bool resume = false;
+};
@@ -1,5 +1,6 @@
 #include <iostream>
 #include <cmath>
+#include <cstring>
 #include "Scene.hpp"
 #include "Intersection.hpp"
 
@@ -23,6 +24,7 @@ Scene::~Scene()
 void Scene::add(SceneObject *object)
 {
   objects.push_back(object);
+  prepared = false;
 }
 
 void Scene::addLight(Light *light)
@@ -30,15 +32,53 @@ void Scene::addLight(Light *light)
   lights.push_back(light);
 }
 
+void Scene::clearLights()
+{
+  for (int i = 0; i < lights.size(); ++i)
+  {
+    delete lights[i];
+  }
+  lights.clear();
+}
+
+int Scene::addMaterial(Material *material)
+{
+  return materials.intern(material);
+}
+
 void Scene::prepare()
 {
-  
+  // Lights may have been moved or replaced since the previous render (cheap to build)
+  lightGrid.build(lights);
+  if (samplesLights())
+  {
+    lightTree.build(lights);
+  }
+
+  // Geometry stays prepared between renders of the same scene
+  if (prepared)
+  {
+    return;
+  }
+
   const size_t size_objects = objects.size();
   for (int i = 0; i <size_objects; ++i)
   {
     objects[i]->applyTransform();
     objects[i]->calculateBoundingBox();
   }
+  prepared = true;
+}
+
+void Scene::update(SceneObject *object)
+{
+  // Not prepared yet: prepare() transforms every object anyway
+  if (!prepared)
+  {
+    return;
+  }
+  object->applyTransform();
+  object->calculateBoundingBox();
 }
 // optimization : return reference to avoid copy
 const std::vector<Light *> &Scene::getLights()
@@ -51,6 +91,34 @@ const std::vector<Light *> &Scene::getLights()
 // }
 
 bool Scene::closestIntersection(Ray &r, Intersection &closest, CullingType culling)
+{
+  switch (culling)
+  {
+  case CULLING_FRONT:
+    return traverse<CULLING_FRONT, false>(r, closest);
+  case CULLING_BACK:
+    return traverse<CULLING_BACK, false>(r, closest);
+  default:
+    return traverse<CULLING_BOTH, false>(r, closest);
+  }
+}
+
+bool Scene::anyIntersection(Ray &r, CullingType culling)
+{
+  Intersection unused;
+  switch (culling)
+  {
+  case CULLING_FRONT:
+    return traverse<CULLING_FRONT, true>(r, unused);
+  case CULLING_BACK:
+    return traverse<CULLING_BACK, true>(r, unused);
+  default:
+    return traverse<CULLING_BOTH, true>(r, unused);
+  }
+}
+
+template <CullingType culling, bool anyHit>
+bool Scene::traverse(Ray &r, Intersection &closest)
 {
   Intersection intersection;
 
@@ -67,6 +135,16 @@ bool Scene::closestIntersection(Ray &r, Intersection &closest, CullingType culli
       continue;
     }
 
+    // Any-hit query: stop at the first object in the way
+    if (anyHit)
+    {
+      if (objects[i]->occludes(r, culling))
+      {
+        return true;
+      }
+      continue;
+    }
+
     if (objects[i]->intersects(r, intersection, culling))
     {
 
@@ -96,33 +174,135 @@ bool Scene::closestIntersection(Ray &r, Intersection &closest, CullingType culli
   return (closestDistanceSquared > -1);
 }
 
-Color Scene::raycast(Ray &r, Ray &camera, int castCount, int maxCastCount)
+Radiance Scene::raycast(Ray &r, Ray &camera, int castCount, int maxCastCount, float weight)
 {
-
-  Color pixel;
-
   Intersection intersection;
 
   if (closestIntersection(r, intersection, CULLING_FRONT))
   {
     // Add the view-ray for convenience (the direction is normalised in the constructor)
     intersection.View = (camera.GetPosition() - intersection.Position).normalize();
+    return shade(r, camera, intersection, castCount, maxCastCount, weight);
+  }
+
+  return Radiance();
+}
 
-    if (intersection.Mat != NULL)
+Radiance Scene::shade(Ray &r, Ray &camera, Intersection &intersection, int castCount, int maxCastCount, float weight)
+{
+  Radiance pixel;
+
+  if (intersection.MaterialID != NO_MATERIAL)
+  {
+    Material *material = materials.get(intersection.MaterialID);
+    pixel = pixel + material->render(r, camera, &intersection, this);
+
+    // Reflect
+    if (castCount < maxCastCount & material->cReflection > 0)
     {
-      pixel = pixel + (intersection.Mat)->render(r, camera, &intersection, this);
+      Vector3 reflectDir = r.GetDirection().reflect(intersection.Normal);
+      Vector3 origin = intersection.Position + (reflectDir * COMPARE_ERROR_CONSTANT);
+      Ray reflectRay(origin, reflectDir);
 
-      // Reflect
-      if (castCount < maxCastCount & intersection.Mat->cReflection > 0)
+      float factor;
+      if (traceReflection(reflectRay, weight, material->cReflection, factor))
       {
-        Vector3 reflectDir = r.GetDirection().reflect(intersection.Normal);
-        Vector3 origin = intersection.Position + (reflectDir * COMPARE_ERROR_CONSTANT);
-        Ray reflectRay(origin, reflectDir);
-
-        pixel = pixel + raycast(reflectRay, camera, castCount + 1, maxCastCount) * intersection.Mat->cReflection;
+        pixel = pixel + raycast(reflectRay, camera, castCount + 1, maxCastCount, weight * material->cReflection) * factor;
       }
     }
   }
 
   return pixel;
-}
\ No newline at end of file
+}
+
+// Reflected rays traced by each render thread
+static thread_local long reflectionCount = 0;
+
+// Mixes the bits of a 64-bit value (splitmix64 finalizer)
+static uint64_t mix(uint64_t x)
+{
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+bool Scene::traceReflection(Ray const &reflected, float weight, float reflectivity, float &factor) const
+{
+  factor = reflectivity;
+  const float reflectedWeight = weight * reflectivity;
+  if (reflectedWeight < termination.threshold)
+  {
+    if (!termination.russianRoulette)
+    {
+      return false;
+    }
+
+    // Random number from the ray itself: reproducible
+    uint64_t h = 0;
+    Vector3 o = reflected.GetPosition();
+    Vector3 d = reflected.GetDirection();
+    for (double component : {o.x, o.y, o.z, d.x, d.y, d.z})
+    {
+      uint64_t bits;
+      std::memcpy(&bits, &component, sizeof(bits));
+      h = mix(h ^ bits);
+    }
+    const float u = (h >> 40) * (1.0f / 16777216.0f);
+    const float probability = reflectedWeight / termination.threshold;
+    if (u >= probability)
+    {
+      return false;
+    }
+    factor = reflectivity / probability;
+  }
+  reflectionCount++;
+  return true;
+}
+
+long Scene::takeReflectionCount()
+{
+  long count = reflectionCount;
+  reflectionCount = 0;
+  return count;
+}
+
+void Scene::selectLights(Vector3 const &point, std::vector<LightSample> &selection) const
+{
+  selection.clear();
+  auto add = [&](Light *light, float weight)
+  {
+    weight *= light->Attenuation((light->GetPosition() - point).lengthSquared());
+    if (weight > 0)
+    {
+      selection.push_back({light, weight});
+    }
+  };
+
+  // Only the lights that can reach the point
+  if (!samplesLights())
+  {
+    lightGrid.forEach(point, [&](int light)
+                      { add(lights[light], 1); });
+    return;
+  }
+
+  uint64_t h = 0;
+  for (double component : {point.x, point.y, point.z})
+  {
+    uint64_t bits;
+    std::memcpy(&bits, &component, sizeof(bits));
+    h = mix(h ^ bits);
+  }
+
+  for (int i = 0; i < lightSampling.samples; ++i)
+  {
+    h = mix(h + i);
+    double u = (h >> 11) * (1.0 / 9007199254740992.0);
+    float probability;
+    int light = lightTree.sample(point, u, probability);
+    if (light >= 0)
+    {
+      add(lights[light], 1.0f / (lightSampling.samples * probability));
+    }
+  }
+}
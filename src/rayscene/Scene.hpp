@@ -1,31 +1,129 @@
 #pragma once
 
 #include <vector>
+#include <cstdint>
 #include "../raymath/Ray.hpp"
 #include "../raymath/Color.hpp"
+#include "../raymath/Radiance.hpp"
 #include "Light.hpp"
+#include "LightTree.hpp"
+#include "LightGrid.hpp"
 #include "SceneObject.hpp"
+#include "MaterialTable.hpp"
+
+/**
+ * Stops the reflection paths that can no longer visibly change the pixel.
+ * The weight of a reflected ray is the product of the reflectivities along
+ * its path: its radiance is scaled by it.
+ */
+struct PathTermination
+{
+  // Reflected rays lighter than this are not traced (0 = all traced, up to the reflection depth)
+  float threshold = 0;
+  // Instead, trace them with probability weight / threshold and divide their radiance by it:
+  // the same image on average (unbiased), with some noise
+  bool russianRoulette = false;
+};
+
+/**
+ * Many lights: each point is shaded with a few lights picked at random from the
+ * light tree, with probabilities proportional to their estimated contribution,
+ * instead of all of them. Each picked light is weighted by 1 / (samples x its
+ * probability): the image is the same on average, with some noise.
+ */
+struct LightSampling
+{
+  // Lights picked per shaded point (0 = every light, no sampling)
+  int samples = 0;
+};
+
+// A light used to shade a point, and the factor of its contribution
+struct LightSample
+{
+  Light *light;
+  float weight;
+};
 
 class Scene
 {
 private:
   std::vector<SceneObject *> objects;
   std::vector<Light *> lights;
+  MaterialTable materials;
+  LightTree lightTree;
+  LightGrid lightGrid;
+  // Transforms applied and bounding boxes computed since the last change
+  bool prepared = false;
+
+  /**
+   * Object loop specialised on the culling mode and on the kind of query
+   * (closest hit or any hit), instantiated once per combination.
+   */
+  template <CullingType culling, bool anyHit>
+  bool traverse(Ray &r, Intersection &closest);
 
 public:
   Scene();
   ~Scene();
 
   Color globalAmbient;
+  PathTermination termination;
+  LightSampling lightSampling;
+  // Identifies what is rendered: scene file, OBJ files and render options changing the pixels
+  uint64_t contentHash = 0;
 
   void add(SceneObject *object);
   void addLight(Light *light);
+  // Deletes the lights of the scene
+  void clearLights();
+  // Takes ownership of the material, returns its ID (shared with identical materials)
+  int addMaterial(Material *material);
+  MaterialTable &getMaterials() { return materials; };
+  Material *getMaterial(int id) const { return materials.get(id); };
   // optimization : return reference to avoid copy
   const std::vector<Light *> &getLights();
   // std::vector<Light *> getLights();
 
   void prepare();
-  Color raycast(Ray &r, Ray &camera, int castCount, int maxCastCount);
+  const std::vector<SceneObject *> &getObjects() const { return objects; };
+  // Applies again the transform of one object that moved (the others stay prepared)
+  void update(SceneObject *object);
+  // `weight`: product of the reflectivities of the path of r (1 for a camera ray)
+  Radiance raycast(Ray &r, Ray &camera, int castCount, int maxCastCount, float weight = 1);
+  /**
+   * Radiance leaving the hit of the ray `r` (its View set): the material lighting
+   * (shadow rays) and the reflections. raycast() without the closest-hit search.
+   */
+  Radiance shade(Ray &r, Ray &camera, Intersection &intersection, int castCount, int maxCastCount, float weight = 1);
+
+  /**
+   * Path termination: whether the ray `reflected`, leaving a material of
+   * `reflectivity` at the end of a path of `weight`, is traced. If so, its
+   * radiance is to be multiplied by `factor` (the reflectivity, divided by the
+   * probability of tracing it with Russian roulette). The choice only depends
+   * on the ray, so it is the same for every integrator and thread count.
+   */
+  bool traceReflection(Ray const &reflected, float weight, float reflectivity, float &factor) const;
+  // Reflected rays traced by the calling thread since the previous call
+  static long takeReflectionCount();
+
+  // Whether the points are shaded with some lights picked from the light tree
+  bool samplesLights() const { return lightSampling.samples > 0 && (int)lights.size() > lightSampling.samples; };
+  /**
+   * Whether each point is shaded with its own list of weighted lights
+   * (selectLights): with light sampling, or when lights have an influence radius.
+   * Otherwise every light shades every point at full weight.
+   */
+  bool selectsLights() const { return samplesLights() || !lightGrid.empty(); };
+  /**
+   * The lights that shade `point`, in the order they are used, weighted by
+   * their attenuation (and the sampling weight), leaving out the lights that
+   * cannot reach it. The choice only depends on the point (same for every
+   * integrator and thread count).
+   */
+  void selectLights(Vector3 const &point, std::vector<LightSample> &selection) const;
 
   bool closestIntersection(Ray &r, Intersection &closest, CullingType culling);
+  // Shadow rays only need to know whether something is in the way
+  bool anyIntersection(Ray &r, CullingType culling);
 };
@@ -0,0 +1,44 @@
+#include <algorithm>
+#include "SceneCache.hpp"
+#include "SceneLoader.hpp"
+
+SceneCache::SceneCache(size_t capacity) : capacity(std::max(capacity, (size_t)1))
+{
+}
+
+SceneCache::~SceneCache()
+{
+  for (Entry &entry : entries)
+  {
+    delete entry.scene;
+  }
+}
+
+Scene *SceneCache::get(nlohmann::json const &data, std::filesystem::path const &sceneDirectory, bool &hit)
+{
+  uint64_t key = SceneLoader::HashScene(data, sceneDirectory);
+
+  for (auto it = entries.begin(); it != entries.end(); ++it)
+  {
+    if (it->key == key)
+    {
+      // Move to the front: most recently used
+      entries.splice(entries.begin(), entries, it);
+      hits++;
+      hit = true;
+      return entries.front().scene;
+    }
+  }
+
+  Scene *scene = SceneLoader::LoadScene(data, sceneDirectory);
+  misses++;
+  hit = false;
+
+  entries.push_front({key, scene});
+  while (entries.size() > capacity)
+  {
+    delete entries.back().scene;
+    entries.pop_back();
+  }
+  return scene;
+}
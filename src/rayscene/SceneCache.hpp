@@ -0,0 +1,45 @@
+#pragma once
+
+#include <list>
+#include <cstdint>
+#include <filesystem>
+#include "../json/json.hpp"
+#include "Scene.hpp"
+
+/**
+ * Loaded scenes kept in memory between renders, keyed by SceneLoader::HashScene
+ * (same objects, lights, materials and OBJ files): a cached scene is neither
+ * parsed nor prepared again. Beyond `capacity` scenes, the least recently used
+ * one is deleted.
+ */
+class SceneCache
+{
+private:
+  struct Entry
+  {
+    uint64_t key;
+    Scene *scene;
+  };
+
+  // Most recently used first
+  std::list<Entry> entries;
+  size_t capacity;
+  long hits = 0;
+  long misses = 0;
+
+public:
+  SceneCache(size_t capacity);
+  ~SceneCache();
+  SceneCache(SceneCache const &) = delete;
+  SceneCache &operator=(SceneCache const &) = delete;
+
+  /**
+   * Scene of a parsed scene file, loaded if it is not cached. The cache keeps
+   * the ownership: the scene is valid until the next call.
+   */
+  Scene *get(nlohmann::json const &data, std::filesystem::path const &sceneDirectory, bool &hit);
+
+  long getHits() const { return hits; };
+  long getMisses() const { return misses; };
+  size_t size() const { return entries.size(); };
+};
@@ -0,0 +1,344 @@
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include "SceneDiff.hpp"
+#include "SceneLoader.hpp"
+#include "TileScheduler.hpp"
+#include "Plane.hpp"
+
+using json = nlohmann::json;
+
+/**
+ * Bounding rectangle (frame pixels) of projected points. `unbounded` when one
+ * of the points cannot be projected: the footprint may then cover the whole frame.
+ */
+struct Footprint
+{
+  double x0 = std::numeric_limits<double>::max();
+  double y0 = std::numeric_limits<double>::max();
+  double x1 = std::numeric_limits<double>::lowest();
+  double y1 = std::numeric_limits<double>::lowest();
+  bool unbounded = false;
+
+  void add(bool projected, double px, double py)
+  {
+    if (!projected)
+    {
+      unbounded = true;
+      return;
+    }
+    x0 = std::min(x0, px);
+    y0 = std::min(y0, py);
+    x1 = std::max(x1, px);
+    y1 = std::max(y1, py);
+  }
+};
+
+/**
+ * What the shadow of a box can fall on: the planes, and the box around the
+ * other (finite) objects, of which only the z extent is used.
+ */
+struct Receivers
+{
+  std::vector<Plane *> planes;
+  bool finite = false;
+  double z0 = 0;
+  double z1 = 0;
+
+  explicit Receivers(Scene &scene)
+  {
+    for (SceneObject *object : scene.getObjects())
+    {
+      if (Plane *plane = dynamic_cast<Plane *>(object))
+      {
+        planes.push_back(plane);
+        continue;
+      }
+      AABB const &box = object->getBoundingBox();
+      z0 = finite ? std::min(z0, box.getMin().z) : box.getMin().z;
+      z1 = finite ? std::max(z1, box.getMax().z) : box.getMax().z;
+      finite = true;
+    }
+  }
+};
+
+/**
+ * A region of space bounded by rays: the convex hull of `base` (points) and of
+ * the rays `origins[i] + s * directions[i]`, s >= 0.
+ */
+struct Cone
+{
+  std::vector<Vector3> base;
+  std::vector<Vector3> origins;
+  std::vector<Vector3> directions;
+};
+
+/**
+ * Adds the part of a cone lying between the planes z = z0 and z = z1. The base
+ * points, when they overlap the slab, are cut to it by clamping their z.
+ */
+void addSlab(Footprint &footprint, Cone const &cone, double z0, double z1, Camera const &camera)
+{
+  double px, py;
+  bool startsBeforeZ1 = false;
+  bool endsAfterZ0 = false;
+  for (Vector3 const &point : cone.base)
+  {
+    startsBeforeZ1 = startsBeforeZ1 || point.z <= z1;
+    endsAfterZ0 = endsAfterZ0 || point.z >= z0;
+  }
+  for (Vector3 const &point : cone.base)
+  {
+    if (startsBeforeZ1 && endsAfterZ0)
+    {
+      Vector3 clamped(point.x, point.y, std::clamp(point.z, z0, z1));
+      footprint.add(camera.project(clamped, px, py), px, py);
+    }
+  }
+  for (size_t i = 0; i < cone.origins.size(); ++i)
+  {
+    Vector3 const &o = cone.origins[i];
+    Vector3 const &d = cone.directions[i];
+    if (d.z == 0)
+    {
+      if (o.z >= z0 && o.z <= z1)
+      {
+        footprint.add(false, 0, 0);
+      }
+      continue;
+    }
+    double a = (z0 - o.z) / d.z;
+    double b = (z1 - o.z) / d.z;
+    double lo = std::max(0.0, std::min(a, b));
+    double hi = std::max(a, b);
+    if (hi < lo)
+    {
+      continue;
+    }
+    footprint.add(camera.project(o + d * lo, px, py), px, py);
+    footprint.add(camera.project(o + d * hi, px, py), px, py);
+  }
+}
+
+/**
+ * Adds the part of a cone lying on a plane: the points where its rays meet the
+ * plane, and its base points when they are not all strictly on one side. The
+ * part is unbounded when only some of the rays meet the plane.
+ */
+void addPlane(Footprint &footprint, Cone const &cone, Plane const &plane, Camera const &camera)
+{
+  Vector3 const &n = plane.getNormal();
+  double px, py;
+  int hits = 0;
+  std::vector<Vector3> points;
+  for (size_t i = 0; i < cone.origins.size(); ++i)
+  {
+    double side = (cone.origins[i] - plane.getPoint()).dot(n);
+    double towards = cone.directions[i].dot(n);
+    if (side == 0)
+    {
+      points.push_back(cone.origins[i]);
+      hits++;
+    }
+    else if (side * towards < 0)
+    {
+      points.push_back(cone.origins[i] + cone.directions[i] * (-side / towards));
+      hits++;
+    }
+  }
+
+  int above = 0;
+  int below = 0;
+  for (Vector3 const &point : cone.base)
+  {
+    double side = (point - plane.getPoint()).dot(n);
+    above += side > 0;
+    below += side < 0;
+  }
+  bool oneSide = above == (int)cone.base.size() || below == (int)cone.base.size();
+  if (hits == 0 && oneSide)
+  {
+    return;
+  }
+  if (hits < (int)cone.origins.size())
+  {
+    footprint.add(false, 0, 0);
+    return;
+  }
+  if (!oneSide)
+  {
+    points.insert(points.end(), cone.base.begin(), cone.base.end());
+  }
+  for (Vector3 const &point : points)
+  {
+    footprint.add(camera.project(point, px, py), px, py);
+  }
+}
+
+/**
+ * Footprint of an object and of its shadows. A shadow ray is not limited to the
+ * light distance: the box shadows the points on the rays going from the light
+ * away from it, and the points on the rays going from the light towards it
+ * (occluder behind the light). Both cones are cut to what they can fall on.
+ */
+Footprint objectFootprint(SceneObject *object, Scene &scene, Camera const &camera)
+{
+  Footprint footprint;
+  AABB const &box = object->getBoundingBox();
+  Vector3 const &min = box.getMin();
+  Vector3 const &max = box.getMax();
+  Receivers receivers(scene);
+
+  std::vector<Vector3> corners;
+  for (int i = 0; i < 8; ++i)
+  {
+    corners.push_back(Vector3(i & 1 ? max.x : min.x, i & 2 ? max.y : min.y, i & 4 ? max.z : min.z));
+  }
+
+  double px, py;
+  for (Vector3 const &corner : corners)
+  {
+    footprint.add(camera.project(corner, px, py), px, py);
+  }
+
+  for (Light *light : scene.getLights())
+  {
+    Vector3 l = light->GetPosition();
+    Cone beyond;
+    Cone behind;
+    for (Vector3 const &corner : corners)
+    {
+      beyond.origins.push_back(corner);
+      beyond.directions.push_back(corner - l);
+      behind.origins.push_back(l);
+      behind.directions.push_back(l - corner);
+    }
+    beyond.base = corners;
+    behind.base.push_back(l);
+    for (Cone const *cone : {&beyond, &behind})
+    {
+      if (receivers.finite)
+      {
+        addSlab(footprint, *cone, receivers.z0, receivers.z1, camera);
+      }
+      for (Plane *plane : receivers.planes)
+      {
+        addPlane(footprint, *cone, *plane, camera);
+      }
+    }
+  }
+  return footprint;
+}
+
+/**
+ * Marks the tiles of the region covered by a footprint, grown by one pixel
+ * (anti-aliasing compares each pixel with its neighbours).
+ */
+void markTiles(Footprint const &footprint, RenderRegion const &region, int tileSize, std::vector<bool> &mask)
+{
+  // Clamped before the conversion: a footprint can be far larger than the frame
+  auto clampX = [&](double x)
+  { return (int)std::clamp(x - region.x, -2.0, region.width + 2.0); };
+  auto clampY = [&](double y)
+  { return (int)std::clamp(y - region.y, -2.0, region.height + 2.0); };
+  int x0 = std::max(clampX(std::floor(footprint.x0) - 1), 0);
+  int y0 = std::max(clampY(std::floor(footprint.y0) - 1), 0);
+  int x1 = std::min(clampX(std::ceil(footprint.x1) + 2), region.width);
+  int y1 = std::min(clampY(std::ceil(footprint.y1) + 2), region.height);
+  const int columns = (region.width + tileSize - 1) / tileSize;
+
+  for (int ty = y0 / tileSize; ty * tileSize < y1; ++ty)
+  {
+    for (int tx = x0 / tileSize; tx * tileSize < x1; ++tx)
+    {
+      mask[ty * columns + tx] = true;
+    }
+  }
+}
+
+// Identifies an object entry, with the contents of its OBJ file
+uint64_t objectHash(json const &object, std::filesystem::path const &sceneDirectory)
+{
+  return SceneLoader::Hash(json{{"objects", json::array({object})}}, sceneDirectory);
+}
+
+bool reflective(Scene &scene)
+{
+  MaterialTable &materials = scene.getMaterials();
+  for (size_t id = 0; id < materials.size(); ++id)
+  {
+    if (materials.get(id)->cReflection > 0)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool SceneDiff::dirtyTiles(json const &before, std::filesystem::path const &beforeDirectory,
+                           json const &after, std::filesystem::path const &afterDirectory, Scene &beforeScene, Scene &afterScene, Camera const &camera, Image const &image,
+                           std::vector<bool> &mask, int &changedObjects, std::string &reason)
+{
+  json beforeRest = before;
+  json afterRest = after;
+  beforeRest.erase("objects");
+  afterRest.erase("objects");
+  if (SceneLoader::Hash(beforeRest, beforeDirectory) != SceneLoader::Hash(afterRest, afterDirectory))
+  {
+    reason = "not only objects changed (camera, lights, materials, image or render settings)";
+    return false;
+  }
+  if (camera.Reflections > 0 && (reflective(beforeScene) || reflective(afterScene)))
+  {
+    reason = "reflections are on";
+    return false;
+  }
+
+  beforeScene.prepare();
+  afterScene.prepare();
+
+  RenderRegion region = camera.getRegion(image);
+  const int tileSize = std::max(camera.Settings.tileSize, 1);
+  mask.assign(TileScheduler::gridTileCount(region.width, region.height, tileSize), false);
+  changedObjects = 0;
+
+  json const empty = json::array();
+  json const &beforeObjects = before.contains("objects") ? before["objects"] : empty;
+  json const &afterObjects = after.contains("objects") ? after["objects"] : empty;
+  std::vector<int> beforeIndices = SceneLoader::ObjectIndices(before);
+  std::vector<int> afterIndices = SceneLoader::ObjectIndices(after);
+
+  for (size_t i = 0; i < std::max(beforeObjects.size(), afterObjects.size()); ++i)
+  {
+    bool inBefore = i < beforeObjects.size() && beforeIndices[i] >= 0;
+    bool inAfter = i < afterObjects.size() && afterIndices[i] >= 0;
+    if (inBefore && inAfter && objectHash(beforeObjects[i], beforeDirectory) == objectHash(afterObjects[i], afterDirectory))
+    {
+      continue;
+    }
+    if (!inBefore && !inAfter)
+    {
+      continue;
+    }
+    changedObjects++;
+
+    // Where the object was, and where it is
+    for (int version = 0; version < 2; ++version)
+    {
+      if (!(version == 0 ? inBefore : inAfter))
+      {
+        continue;
+      }
+      Scene &scene = version == 0 ? beforeScene : afterScene;
+      SceneObject *object = scene.getObjects()[version == 0 ? beforeIndices[i] : afterIndices[i]];
+      Footprint footprint = objectFootprint(object, scene, camera);
+      if (footprint.unbounded)
+      {
+        reason = "object " + std::to_string(i) + " (or its shadow) is not bounded on screen";
+        return false;
+      }
+      markTiles(footprint, region, tileSize, mask);
+    }
+  }
+  return true;
+}
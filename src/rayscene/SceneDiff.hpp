@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <filesystem>
+#include "../json/json.hpp"
+#include "../rayimage/Image.hpp"
+#include "Scene.hpp"
+#include "Camera.hpp"
+
+/**
+ * Incremental re-rendering: the tiles of a frame that can change between two
+ * versions of a scene file in which only some objects changed.
+ *
+ * A changed object can only change the pixels where it is seen (before and
+ * after the change) and the pixels where its shadow falls: the tiles covered
+ * by the screen footprint of its bounding box, and by the footprint of the box
+ * extruded through each light. Other changes (camera, lights, materials,
+ * image, render settings) and reflections need a full render.
+ */
+class SceneDiff
+{
+public:
+  /**
+   * Sets `mask` (grid indices of the tiles of the region rendered by `camera`
+   * into `image`) to the tiles that may differ, and counts the changed objects.
+   * `before` and `after` are the parsed scene files (their OBJ files relative to
+   * `beforeDirectory` and `afterDirectory`), `beforeScene` and `afterScene`
+   * their loaded scenes (prepared here).
+   * Returns false, with `reason` set, when the whole frame must be rendered again.
+   */
+  static bool dirtyTiles(nlohmann::json const &before, std::filesystem::path const &beforeDirectory,
+                         nlohmann::json const &after, std::filesystem::path const &afterDirectory,
+                         Scene &beforeScene, Scene &afterScene,
+                         Camera const &camera, Image const &image, std::vector<bool> &mask, int &changedObjects,
+                         std::string &reason);
+};
@@ -1,6 +1,9 @@
 #include <iostream>
 #include <fstream>
 #include <filesystem>
+#include <stdexcept>
+#include <cmath>
+#include <algorithm>
 #include "../json/json.hpp"
 #include "SceneLoader.hpp"
 #include "Sphere.hpp"
@@ -11,6 +14,7 @@
 #include "Light.hpp"
 #include "PhongMaterial.hpp"
 #include "CheckerMaterial.hpp"
+#include "Hash.hpp"
 
 using json = nlohmann::json;
 
@@ -82,7 +86,52 @@ Material *parseMaterial(json data)
     return nullptr;
 }
 
-Sphere *parseSphere(json data)
+/**
+ * Resolves the "material" entry of an object to an ID of the scene material table:
+ * either the name of a material of the top-level "materials" section,
+ * or an inline material definition (deduplicated by content).
+ */
+int parseMaterialReference(json data, Scene *scene)
+{
+    if (data.is_string())
+    {
+        std::string name = data;
+        int id = scene->getMaterials().find(name);
+        if (id == NO_MATERIAL)
+        {
+            throw std::runtime_error("unknown material: " + name);
+        }
+        return id;
+    }
+
+    Material *mat = parseMaterial(data);
+    if (mat == nullptr)
+    {
+        return NO_MATERIAL;
+    }
+    return scene->addMaterial(mat);
+}
+
+void parseMaterials(json data, Scene *scene)
+{
+    if (!data.contains("materials"))
+    {
+        return;
+    }
+
+    for (auto &elem : data["materials"].items())
+    {
+        Material *mat = parseMaterial(elem.value());
+        if (mat == nullptr)
+        {
+            throw std::runtime_error("unknown type for material: " + elem.key());
+        }
+        // Not deduplicated: each name can be edited on its own (Raytracer::setMaterials)
+        scene->getMaterials().setName(elem.key(), scene->getMaterials().add(mat));
+    }
+}
+
+Sphere *parseSphere(json data, Scene *scene)
 {
     double radius = data["radius"];
 
@@ -99,17 +148,13 @@ Sphere *parseSphere(json data)
     }
     if (data.contains("material"))
     {
-        Material *mat = parseMaterial(data["material"]);
-        if (mat != nullptr)
-        {
-            s->material = mat;
-        }
+        s->materialID = parseMaterialReference(data["material"], scene);
     }
 
     return s;
 }
 
-Plane *parsePlane(json data)
+Plane *parsePlane(json data, Scene *scene)
 {
     Vector3 pos;
     Vector3 norm(0, 1, 0);
@@ -127,17 +172,13 @@ Plane *parsePlane(json data)
 
     if (data.contains("material"))
     {
-        Material *mat = parseMaterial(data["material"]);
-        if (mat != nullptr)
-        {
-            plane->material = mat;
-        }
+        plane->materialID = parseMaterialReference(data["material"], scene);
     }
 
     return plane;
 }
 
-Triangle *parseTriangle(json data)
+Triangle *parseTriangle(json data, Scene *scene)
 {
     Vector3 pos;
     Vector3 rot;
@@ -159,13 +200,11 @@ Triangle *parseTriangle(json data)
         auto &verts = data["vertices"];
         if (!verts.is_array())
         {
-            std::cerr << "vertices entry for a an object of type triangle must be an array" << std::endl;
-            exit(1);
+            throw std::runtime_error("vertices entry for a an object of type triangle must be an array");
         }
         if (verts.size() != 3)
         {
-            std::cerr << "vertices array for a an object of type triangle must have 3 vectors" << std::endl;
-            exit(1);
+            throw std::runtime_error("vertices array for a an object of type triangle must have 3 vectors");
         }
 
         A = parseVector3(verts.at(0));
@@ -179,17 +218,13 @@ Triangle *parseTriangle(json data)
 
     if (data.contains("material"))
     {
-        Material *mat = parseMaterial(data["material"]);
-        if (mat != nullptr)
-        {
-            triangle->material = mat;
-        }
+        triangle->materialID = parseMaterialReference(data["material"], scene);
     }
 
     return triangle;
 }
 
-Mesh *parseMesh(json data, std::filesystem::path &sceneParentPath)
+Mesh *parseMesh(json data, Scene *scene, std::filesystem::path &sceneParentPath)
 {
 
     Mesh *mesh = new Mesh();
@@ -216,8 +251,7 @@ Mesh *parseMesh(json data, std::filesystem::path &sceneParentPath)
         std::ifstream f(fullPath);
         if (!f.good())
         {
-            std::cerr << "obj file not found at path: " << fullPath << std::endl;
-            exit(1);
+            throw std::runtime_error("obj file not found at path: " + fullPath.string());
         }
 
         mesh->loadFromObj(fullPath);
@@ -225,11 +259,7 @@ Mesh *parseMesh(json data, std::filesystem::path &sceneParentPath)
 
     if (data.contains("material"))
     {
-        Material *mat = parseMaterial(data["material"]);
-        if (mat != nullptr)
-        {
-            mesh->material = mat;
-        }
+        mesh->materialID = parseMaterialReference(data["material"], scene);
     }
 
     return mesh;
@@ -247,22 +277,22 @@ void parseOjects(json data, Scene *scene, std::filesystem::path &sceneParentPath
         std::string type = elem["type"];
         if (type == "sphere")
         {
-            Sphere *s = parseSphere(elem);
+            Sphere *s = parseSphere(elem, scene);
             scene->add(s);
         }
         else if (type == "plane")
         {
-            Plane *p = parsePlane(elem);
+            Plane *p = parsePlane(elem, scene);
             scene->add(p);
         }
         else if (type == "triangle")
         {
-            Triangle *t = parseTriangle(elem);
+            Triangle *t = parseTriangle(elem, scene);
             scene->add(t);
         }
         else if (type == "mesh")
         {
-            Mesh *m = parseMesh(elem, sceneParentPath);
+            Mesh *m = parseMesh(elem, scene, sceneParentPath);
             scene->add(m);
         }
     }
@@ -285,29 +315,258 @@ Light *parsePointLight(json data)
     {
         light->Specular = parseColor(data["specular"]);
     }
+    if (data.contains("radius"))
+    {
+        light->Radius = data["radius"];
+    }
 
     return light;
 }
 
-void parseLights(json data, Scene *scene)
+// Parses every light before returning any: nothing leaks if one is malformed
+std::vector<Light *> parseLightList(json data)
 {
+    std::vector<Light *> lights;
     if (!data.contains("lights"))
+    {
+        return lights;
+    }
+
+    try
+    {
+        for (auto &elem : data["lights"])
+        {
+            std::string type = elem["type"];
+            if (type == "point")
+            {
+                lights.push_back(parsePointLight(elem));
+            }
+        }
+    }
+    catch (...)
+    {
+        for (Light *light : lights)
+        {
+            delete light;
+        }
+        throw;
+    }
+    return lights;
+}
+
+void parseLights(json data, Scene *scene)
+{
+    for (Light *light : parseLightList(data))
+    {
+        scene->addLight(light);
+    }
+}
+
+TileOrder parseTileOrder(std::string name)
+{
+    if (name == "scanline")
+    {
+        return TILE_ORDER_SCANLINE;
+    }
+    else if (name == "morton")
+    {
+        return TILE_ORDER_MORTON;
+    }
+    else if (name == "hilbert")
+    {
+        return TILE_ORDER_HILBERT;
+    }
+    throw std::runtime_error("unknown tile order: " + name + " (expected scanline, morton or hilbert)");
+}
+
+Integrator parseIntegrator(std::string name)
+{
+    if (name == "recursive")
+    {
+        return INTEGRATOR_RECURSIVE;
+    }
+    else if (name == "wavefront")
+    {
+        return INTEGRATOR_WAVEFRONT;
+    }
+    throw std::runtime_error("unknown integrator: " + name + " (expected recursive or wavefront)");
+}
+
+void parseAntialiasing(json data, AntialiasingSettings &aa)
+{
+    if (data.contains("mode"))
+    {
+        std::string mode = data["mode"];
+        if (mode == "none")
+        {
+            aa.mode = AA_NONE;
+        }
+        else if (mode == "adaptive")
+        {
+            aa.mode = AA_ADAPTIVE;
+        }
+        else
+        {
+            throw std::runtime_error("unknown anti-aliasing mode: " + mode + " (expected none or adaptive)");
+        }
+    }
+    if (data.contains("minSamples"))
+    {
+        aa.minSamples = data["minSamples"];
+    }
+    if (data.contains("maxSamples"))
+    {
+        aa.maxSamples = data["maxSamples"];
+    }
+    if (data.contains("threshold"))
+    {
+        aa.threshold = data["threshold"];
+    }
+    if (data.contains("filter"))
+    {
+        std::string filter = data["filter"];
+        if (filter == "box")
+        {
+            aa.filter = FILTER_BOX;
+        }
+        else if (filter == "tent")
+        {
+            aa.filter = FILTER_TENT;
+        }
+        else if (filter == "gaussian")
+        {
+            aa.filter = FILTER_GAUSSIAN;
+        }
+        else
+        {
+            throw std::runtime_error("unknown reconstruction filter: " + filter + " (expected box, tent or gaussian)");
+        }
+    }
+}
+
+void parseRegion(json data, RenderRegion &region)
+{
+    region.x = data.value("x", 0);
+    region.y = data.value("y", 0);
+    region.width = data.value("width", 0);
+    region.height = data.value("height", 0);
+    region.crop = data.value("crop", false);
+}
+
+void parseTiles(json const &tilesJson, TileSubset &tiles)
+{
+    tiles.begin = tilesJson.value("begin", 0);
+    tiles.end = tilesJson.value("end", -1);
+    tiles.step = tilesJson.value("step", 1);
+}
+
+void parseRenderSettings(json data, Camera *camera)
+{
+    if (!data.contains("render"))
     {
         return;
     }
 
-    for (auto &elem : data["lights"])
+    json renderJson = data["render"];
+    if (renderJson.contains("threads"))
     {
-        std::string type = elem["type"];
-        if (type == "point")
+        camera->Settings.threads = renderJson["threads"];
+    }
+    if (renderJson.contains("pinThreads"))
+    {
+        camera->Settings.pinThreads = renderJson["pinThreads"];
+    }
+    if (renderJson.contains("tileSize"))
+    {
+        camera->Settings.tileSize = renderJson["tileSize"];
+    }
+    if (renderJson.contains("tileOrder"))
+    {
+        camera->Settings.tileOrder = parseTileOrder(renderJson["tileOrder"]);
+    }
+    if (renderJson.contains("integrator"))
+    {
+        camera->Settings.integrator = parseIntegrator(renderJson["integrator"]);
+    }
+    if (renderJson.contains("sortRays"))
+    {
+        camera->Settings.sortRays = renderJson["sortRays"];
+    }
+    if (renderJson.contains("timeBudget"))
+    {
+        camera->Settings.timeBudget = renderJson["timeBudget"];
+    }
+    if (renderJson.contains("region"))
+    {
+        parseRegion(renderJson["region"], camera->Settings.region);
+    }
+    if (renderJson.contains("tiles"))
+    {
+        parseTiles(renderJson["tiles"], camera->Settings.tiles);
+    }
+    if (renderJson.contains("checkpoint"))
+    {
+        camera->Settings.checkpoint = renderJson["checkpoint"];
+    }
+    if (renderJson.contains("checkpointInterval"))
+    {
+        camera->Settings.checkpointInterval = renderJson["checkpointInterval"];
+    }
+    if (renderJson.contains("resume"))
+    {
+        camera->Settings.resume = renderJson["resume"];
+    }
+    if (renderJson.contains("antialiasing"))
+    {
+        parseAntialiasing(renderJson["antialiasing"], camera->Settings.antialiasing);
+    }
+}
+
+void parseCamera(json data, Camera *camera)
+{
+    if (!data.contains("camera"))
+    {
+        return;
+    }
+
+    json cameraJson = data["camera"];
+    if (cameraJson.contains("position"))
+    {
+        Vector3 pos = parseVector3(cameraJson["position"]);
+        camera->setPosition(pos);
+    }
+    if (cameraJson.contains("lookAt"))
+    {
+        camera->HasTarget = true;
+        camera->Target = parseVector3(cameraJson["lookAt"]);
+    }
+    if (cameraJson.contains("up"))
+    {
+        camera->Up = parseVector3(cameraJson["up"]);
+    }
+    if (cameraJson.contains("fov"))
+    {
+        camera->Fov = cameraJson["fov"];
+        if (!(camera->Fov > 0 && camera->Fov < 180))
         {
-            Light *l = parsePointLight(elem);
-            scene->addLight(l);
+            throw std::runtime_error("camera fov must be between 0 and 180 degrees");
+        }
+    }
+    if (cameraJson.contains("aspect"))
+    {
+        camera->Aspect = cameraJson["aspect"];
+        if (!(camera->Aspect > 0))
+        {
+            throw std::runtime_error("camera aspect must be positive");
         }
     }
 }
 
-Image *parseImage(json data, Image *image)
+/**
+ * Frame resolution from the "image" section. The image only holds the
+ * rendered region when it is cropped.
+ */
+Image *parseImage(json data, Camera *camera)
 {
     unsigned int width = 800;
     unsigned int height = 600;
@@ -326,42 +585,313 @@ Image *parseImage(json data, Image *image)
         }
     }
 
+    camera->FrameWidth = width;
+    camera->FrameHeight = height;
+
+    RenderRegion const &region = camera->Settings.region;
+    if (region.crop && region.width > 0 && region.height > 0)
+    {
+        return new Image(region.width, region.height);
+    }
     return new Image(width, height);
 }
 
-std::tuple<Scene *, Camera *, Image *> SceneLoader::Load(std::string path)
+/**
+ * Hash of the OBJ files loaded by the scene, chained to `hash`.
+ */
+uint64_t hashObjFiles(json const &data, std::filesystem::path const &sceneDirectory, uint64_t hash)
 {
-    std::ifstream f(path);
+    if (data.contains("objects"))
+    {
+        for (auto &elem : data["objects"])
+        {
+            if (elem["type"] == "mesh" && elem.contains("obj"))
+            {
+                std::string relPath = elem["obj"];
+                std::ifstream obj(sceneDirectory / relPath, std::ios::binary);
+                std::string contents((std::istreambuf_iterator<char>(obj)), std::istreambuf_iterator<char>());
+                hash = fnv1a(contents, hash);
+            }
+        }
+    }
+    return hash;
+}
 
-    if (!f.good())
+/**
+ * Hash of everything the pixels depend on: the scene file as canonical JSON
+ * (sorted keys, fixed number formatting), without the render settings that only
+ * change how fast it is rendered, and the contents of the OBJ files.
+ */
+bool SceneLoader::RendersAllTiles(json const &data)
+{
+    TileSubset tiles;
+    if (data.contains("render") && data["render"].contains("tiles"))
     {
-        std::cerr << "Scene file not found at path: " << path << std::endl;
-        exit(1);
+        parseTiles(data["render"]["tiles"], tiles);
     }
+    return tiles.all();
+}
 
-    // Get the parent directory of the scene file (for loading relative mesh files)
-    std::filesystem::path fPath = path;
-    std::filesystem::path parent_p = fPath.parent_path();
+uint64_t SceneLoader::Hash(json data, std::filesystem::path const &sceneDirectory)
+{
+    if (data.contains("render"))
+    {
+        for (auto key : {"threads", "pinThreads", "tileOrder", "integrator", "sortRays", "timeBudget", "checkpoint", "checkpointInterval", "resume", "tiles"})
+        {
+            data["render"].erase(key);
+        }
+        if (data["render"].empty())
+        {
+            data.erase("render");
+        }
+    }
+    return hashObjFiles(data, sceneDirectory, fnv1a(data.dump()));
+}
 
-    json data = json::parse(f);
+uint64_t SceneLoader::HashScene(json const &data, std::filesystem::path const &sceneDirectory)
+{
+    json geometry = json::object();
+    for (auto key : {"lights", "materials", "objects", "ambient", "reflectionTermination", "lightSampling"})
+    {
+        if (data.contains(key))
+        {
+            geometry[key] = data[key];
+        }
+    }
+    return hashObjFiles(data, sceneDirectory, fnv1a(geometry.dump()));
+}
 
+Scene *SceneLoader::LoadScene(json const &data, std::filesystem::path const &sceneDirectory)
+{
+    std::filesystem::path directory = sceneDirectory;
     Scene *scene = new Scene();
+    try
+    {
+        parseLights(data, scene);
+        parseMaterials(data, scene);
+        parseOjects(data, scene, directory);
+
+        if (data.contains("ambient"))
+        {
+            scene->globalAmbient = parseColor(data["ambient"]);
+        }
+        if (data.contains("reflectionTermination"))
+        {
+            json termination = data["reflectionTermination"];
+            scene->termination.threshold = termination.value("threshold", 0.0f);
+            scene->termination.russianRoulette = termination.value("russianRoulette", false);
+        }
+        if (data.contains("lightSampling"))
+        {
+            scene->lightSampling.samples = data["lightSampling"].value("samples", 0);
+        }
+    }
+    catch (...)
+    {
+        delete scene;
+        throw;
+    }
+    return scene;
+}
+
+std::tuple<Camera *, Image *> SceneLoader::LoadView(json data, json const &renderOverrides)
+{
+    if (!renderOverrides.empty())
+    {
+        data["render"].merge_patch(renderOverrides);
+    }
+
     Camera *camera = new Camera();
+    try
+    {
+        if (data.contains("reflections"))
+        {
+            camera->Reflections = data["reflections"];
+        }
 
-    parseLights(data, scene);
-    parseOjects(data, scene, parent_p);
+        parseCamera(data, camera);
+        parseRenderSettings(data, camera);
+        Image *image = parseImage(data, camera);
+        return {camera, image};
+    }
+    catch (...)
+    {
+        delete camera;
+        throw;
+    }
+}
 
-    if (data.contains("ambient"))
+void SceneLoader::LoadLights(json const &data, Scene *scene)
+{
+    // Parsed first: a malformed section keeps the current lights
+    std::vector<Light *> lights = parseLightList(data);
+    scene->clearLights();
+    for (Light *light : lights)
+    {
+        scene->addLight(light);
+    }
+}
+
+void SceneLoader::LoadMaterials(json const &data, Scene *scene)
+{
+    if (!data.contains("materials"))
+    {
+        return;
+    }
+
+    for (auto &elem : data["materials"].items())
+    {
+        int id = scene->getMaterials().find(elem.key());
+        if (id == NO_MATERIAL)
+        {
+            throw std::runtime_error("unknown material: " + elem.key());
+        }
+        Material *mat = parseMaterial(elem.value());
+        if (mat == nullptr)
+        {
+            throw std::runtime_error("unknown type for material: " + elem.key());
+        }
+        scene->getMaterials().replace(id, mat);
+    }
+}
+
+/**
+ * Keyframes of an object or of the camera: [{"frame": 0, "position": {...}, "rotation": {...}}, ...],
+ * each keyframe setting the position, the rotation or both.
+ */
+AnimatedObject parseKeyframes(json data, int object)
+{
+    AnimatedObject animated;
+    animated.object = object;
+    if (data.contains("position"))
+    {
+        animated.position = parseVector3(data["position"]);
+    }
+    if (data.contains("rotation"))
+    {
+        animated.rotation = parseVector3(data["rotation"]);
+    }
+
+    for (auto &key : data["keyframes"])
+    {
+        if (!key.contains("frame"))
+        {
+            throw std::runtime_error("keyframe without a frame number");
+        }
+        double frame = key["frame"];
+        if (key.contains("position"))
+        {
+            animated.positionKeys.add(frame, parseVector3(key["position"]));
+        }
+        if (key.contains("rotation"))
+        {
+            animated.rotationKeys.add(frame, parseVector3(key["rotation"]));
+        }
+    }
+    return animated;
+}
+
+std::vector<int> SceneLoader::ObjectIndices(json const &data)
+{
+    std::vector<int> indices;
+    if (!data.contains("objects"))
+    {
+        return indices;
+    }
+
+    // Same types as parseOjects: the others are skipped
+    int object = 0;
+    for (auto &elem : data["objects"])
+    {
+        std::string type = elem["type"];
+        bool known = type == "sphere" || type == "plane" || type == "triangle" || type == "mesh";
+        indices.push_back(known ? object++ : -1);
+    }
+    return indices;
+}
+
+Animation SceneLoader::LoadAnimation(json const &data)
+{
+    Animation animation;
+    // Without a frame count: up to the last keyframe
+    double lastKeyframe = 0;
+
+    std::vector<int> indices = ObjectIndices(data);
+    for (size_t i = 0; i < indices.size(); ++i)
+    {
+        json const &elem = data["objects"][i];
+        if (indices[i] < 0 || !elem.contains("keyframes"))
+        {
+            continue;
+        }
+        if (elem["type"] == "plane")
+        {
+            throw std::runtime_error("planes cannot be animated");
+        }
+        AnimatedObject animated = parseKeyframes(elem, indices[i]);
+        for (auto *track : {&animated.positionKeys, &animated.rotationKeys})
+        {
+            if (!track->keys.empty())
+            {
+                lastKeyframe = std::max(lastKeyframe, track->keys.back().first);
+            }
+        }
+        animation.addObject(animated);
+    }
+
+    if (data.contains("camera") && data["camera"].contains("keyframes"))
     {
-        scene->globalAmbient = parseColor(data["ambient"]);
+        AnimatedObject camera = parseKeyframes(data["camera"], -1);
+        if (!camera.positionKeys.keys.empty())
+        {
+            lastKeyframe = std::max(lastKeyframe, camera.positionKeys.keys.back().first);
+        }
+        animation.setCamera(camera);
     }
 
-    if (data.contains("reflections"))
+    animation.frameCount = (int)std::ceil(lastKeyframe) + 1;
+    if (data.contains("animation") && data["animation"].contains("frames"))
     {
-        camera->Reflections = data["reflections"];
+        animation.frameCount = data["animation"]["frames"];
     }
+    return animation;
+}
 
-    Image *image = parseImage(data, image);
+std::tuple<Scene *, Camera *, Image *> SceneLoader::Load(json data, std::filesystem::path const &sceneDirectory, json const &renderOverrides)
+{
+    if (!renderOverrides.empty())
+    {
+        data["render"].merge_patch(renderOverrides);
+    }
 
-    return {scene, camera, image};
-}
\ No newline at end of file
+    Scene *scene = LoadScene(data, sceneDirectory);
+    try
+    {
+        auto [camera, image] = LoadView(data);
+        scene->contentHash = Hash(data, sceneDirectory);
+        return {scene, camera, image};
+    }
+    catch (...)
+    {
+        delete scene;
+        throw;
+    }
+}
+
+json SceneLoader::Parse(std::string path)
+{
+    std::ifstream f(path);
+
+    if (!f.good())
+    {
+        throw std::runtime_error("Scene file not found at path: " + path);
+    }
+    return json::parse(f);
+}
+
+std::tuple<Scene *, Camera *, Image *> SceneLoader::Load(std::string path, json const &renderOverrides)
+{
+    // Get the parent directory of the scene file (for loading relative mesh files)
+    std::filesystem::path fPath = path;
+    return Load(Parse(path), fPath.parent_path(), renderOverrides);
+}
@@ -1,12 +1,60 @@
 #pragma once
 
 #include <tuple>
+#include <vector>
+#include <cstdint>
+#include <filesystem>
+#include "../json/json.hpp"
 #include "Scene.hpp"
 #include "Camera.hpp"
+#include "Animation.hpp"
 #include "../rayimage/Image.hpp"
 
 class SceneLoader
 {
 public:
-    static std::tuple<Scene *, Camera *, Image *> Load(std::string path);
+    /**
+     * Loads a scene file. `renderOverrides` (e.g. from the command line) is merged
+     * into the "render" section of the file, its values taking precedence.
+     * Throws std::runtime_error (or a JSON exception) on an invalid scene.
+     */
+    static std::tuple<Scene *, Camera *, Image *> Load(std::string path, nlohmann::json const &renderOverrides = nlohmann::json::object());
+    // Reads the JSON of a scene file
+    static nlohmann::json Parse(std::string path);
+    // Scene file already parsed, its OBJ paths being relative to sceneDirectory
+    static std::tuple<Scene *, Camera *, Image *> Load(nlohmann::json data, std::filesystem::path const &sceneDirectory,
+                                                       nlohmann::json const &renderOverrides = nlohmann::json::object());
+
+    /**
+     * The two parts of Load: what is rendered (objects, lights, materials),
+     * and how it is viewed and rendered (camera, render settings, image).
+     * A loaded scene can be rendered again with other settings.
+     */
+    static Scene *LoadScene(nlohmann::json const &data, std::filesystem::path const &sceneDirectory);
+    static std::tuple<Camera *, Image *> LoadView(nlohmann::json data, nlohmann::json const &renderOverrides = nlohmann::json::object());
+
+    /**
+     * Edits of the lighting of a loaded scene, the geometry being kept:
+     * the lights are replaced by the "lights" section of `data`, and the
+     * named materials by the ones of its "materials" section.
+     */
+    static void LoadLights(nlohmann::json const &data, Scene *scene);
+    static void LoadMaterials(nlohmann::json const &data, Scene *scene);
+
+    /**
+     * Index in the scene objects of each entry of the "objects" section
+     * (-1 for the entries of unknown types, which are not loaded).
+     */
+    static std::vector<int> ObjectIndices(nlohmann::json const &data);
+
+    // Keyframes of the "animation" section, of the objects and of the camera
+    static Animation LoadAnimation(nlohmann::json const &data);
+
+    // Whether a scene file renders every tile (no "render.tiles" subset, which Hash leaves out)
+    static bool RendersAllTiles(nlohmann::json const &data);
+
+    // Identifies what a scene file renders, see Scene::contentHash
+    static uint64_t Hash(nlohmann::json data, std::filesystem::path const &sceneDirectory);
+    // Identifies the objects, lights and materials only (and the OBJ files)
+    static uint64_t HashScene(nlohmann::json const &data, std::filesystem::path const &sceneDirectory);
 };
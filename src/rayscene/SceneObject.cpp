@@ -2,7 +2,7 @@
 #include "SceneObject.hpp"
 #include "Intersection.hpp"
 
-SceneObject::SceneObject() : material(NULL)
+SceneObject::SceneObject() : materialID(NO_MATERIAL)
 {
 }
 
@@ -15,6 +15,12 @@ bool SceneObject::intersects(Ray &r, Intersection &intersection, CullingType cul
   return false;
 }
 
+bool SceneObject::occludes(Ray &r, CullingType culling)
+{
+  Intersection intersection;
+  return this->intersects(r, intersection, culling);
+}
+
 void SceneObject::applyTransform()
 {
 }
@@ -2,7 +2,7 @@
 #include "../raymath/Ray.hpp"
 #include "../raymath/AABB.hpp"
 #include "Intersection.hpp"
-#include "Material.hpp"
+#include "MaterialTable.hpp"
 #include "../raymath/Transform.hpp"
 
 enum CullingType
@@ -17,15 +17,20 @@ class SceneObject
 private:
 public:
   std::string name = "";
-  Material *material = NULL;
+  int materialID = NO_MATERIAL;
   Transform transform;
   AABB boundingBox;
 
   SceneObject();
-  ~SceneObject();
+  virtual ~SceneObject();
 
   virtual void applyTransform();
   virtual bool intersects(Ray &r, Intersection &intersection, CullingType culling);
+  /**
+   * Any-hit query (shadow rays): only tells whether something is hit,
+   * objects may stop at the first hit instead of looking for the closest one.
+   */
+  virtual bool occludes(Ray &r, CullingType culling);
   virtual void calculateBoundingBox() = 0;
   const AABB &getBoundingBox() const { return boundingBox; };
 };
@@ -0,0 +1,178 @@
+#include <iostream>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <regex>
+#include <algorithm>
+#include <stdexcept>
+#include "SequenceRenderer.hpp"
+#include "SceneLoader.hpp"
+#include "TileScheduler.hpp"
+#include "../raythread/ThreadPool.hpp"
+
+#ifdef USE_THREADING
+#include <thread>
+#endif
+
+// Below this many tiles per render thread, a frame does not keep the threads busy
+#define SEQUENCE_MIN_TILES_PER_THREAD 2
+
+SequenceRenderer::SequenceRenderer(nlohmann::json const &data, std::filesystem::path const &sceneDirectory, int concurrentFrames)
+{
+  try
+  {
+    loadSlot(data, sceneDirectory);
+    Camera *camera = slots[0].camera;
+    if (!camera->Settings.checkpoint.empty())
+    {
+      throw std::runtime_error("checkpoints are not supported when rendering a sequence");
+    }
+    frameCount = slots[0].animation.frameCount;
+
+    ThreadPool::configure(camera->Settings.threads, camera->Settings.pinThreads);
+    const int workers = ThreadPool::shared()->size();
+    if (concurrentFrames <= 0)
+    {
+      int tiles = TileScheduler::gridTileCount(camera->FrameWidth, camera->FrameHeight, std::max(camera->Settings.tileSize, 1));
+      concurrentFrames = tiles < SEQUENCE_MIN_TILES_PER_THREAD * workers ? workers : 1;
+    }
+    concurrentFrames = std::min(std::min(concurrentFrames, workers), frameCount);
+
+    while ((int)slots.size() < concurrentFrames)
+    {
+      loadSlot(data, sceneDirectory);
+    }
+  }
+  catch (...)
+  {
+    clear();
+    throw;
+  }
+}
+
+SequenceRenderer::~SequenceRenderer()
+{
+  clear();
+}
+
+void SequenceRenderer::clear()
+{
+  for (Slot &slot : slots)
+  {
+    delete slot.scene;
+    delete slot.camera;
+    delete slot.image;
+  }
+  slots.clear();
+}
+
+void SequenceRenderer::loadSlot(nlohmann::json const &data, std::filesystem::path const &sceneDirectory)
+{
+  slots.emplace_back();
+  Slot &slot = slots.back();
+  slot.animation = SceneLoader::LoadAnimation(data);
+  slot.scene = SceneLoader::LoadScene(data, sceneDirectory);
+  std::tie(slot.camera, slot.image) = SceneLoader::LoadView(data);
+}
+
+std::string SequenceRenderer::frameFileName(std::string const &pattern, int frame)
+{
+  char name[4096];
+  if (std::regex_search(pattern, std::regex("%0?[0-9]*d")) && std::count(pattern.begin(), pattern.end(), '%') == 1)
+  {
+    std::snprintf(name, sizeof(name), pattern.c_str(), frame);
+    return name;
+  }
+
+  std::filesystem::path path = pattern;
+  std::snprintf(name, sizeof(name), "_%04d", frame);
+  return (path.parent_path() / (path.stem().string() + name + path.extension().string())).string();
+}
+
+void SequenceRenderer::render(int first, int last, std::string const &pattern)
+{
+  std::shared_ptr<ThreadPool> pool = ThreadPool::shared();
+  const int concurrent = slots.size();
+
+  std::mutex errorLock;
+  std::string error;
+#ifdef USE_THREADING
+  std::thread encoder;
+#endif
+
+  for (int batchFirst = first; batchFirst <= last; batchFirst += concurrent)
+  {
+    const int count = std::min(concurrent, last - batchFirst + 1);
+    auto begin = std::chrono::steady_clock::now();
+
+    // One frame per thread, each rendered on its thread only (nested jobs run inline).
+    // A single frame is rendered by all the threads.
+    std::vector<int> moved(count);
+    pool->parallelFor(0, count, 1, [&](int i)
+                     {
+      Slot &slot = slots[i];
+      try
+      {
+        moved[i] = slot.animation.apply(batchFirst + i, *slot.scene, *slot.camera);
+        slot.camera->render(*slot.image, *slot.scene);
+      }
+      catch (std::exception const &e)
+      {
+        std::lock_guard<std::mutex> guard(errorLock);
+        error = "frame " + std::to_string(batchFirst + i) + ": " + e.what();
+      } });
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+    for (int i = 0; i < count; ++i)
+    {
+      std::printf("Frame %d: %d objects moved, %.3f s%s\n", batchFirst + i, moved[i], elapsed.count(),
+                  count > 1 ? " (frames rendered together)" : "");
+    }
+    std::fflush(stdout);
+
+    // 8-bit pixels converted here, on the render threads: the encoder thread
+    // only compresses and writes them, without waiting for the pool
+    std::vector<std::vector<unsigned char>> pixels(count);
+    for (int i = 0; i < count && error.empty(); ++i)
+    {
+      Image &image = *slots[i].image;
+      pixels[i].resize((size_t)image.width * image.height * 4);
+      image.toRGBA(pixels[i].data(), image.width * 4);
+    }
+
+    auto encode = [this, count, batchFirst, pattern, pixels = std::move(pixels)]()
+    {
+      for (int i = 0; i < count; ++i)
+      {
+        Image &image = *slots[i].image;
+        Image::writePNG(frameFileName(pattern, batchFirst + i), pixels[i], image.width, image.height);
+      }
+    };
+
+#ifdef USE_THREADING
+    // One frame batch encoded at a time
+    if (encoder.joinable())
+    {
+      encoder.join();
+    }
+    if (!error.empty())
+    {
+      throw std::runtime_error(error);
+    }
+    encoder = std::thread(std::move(encode));
+#else
+    if (!error.empty())
+    {
+      throw std::runtime_error(error);
+    }
+    encode();
+#endif
+  }
+
+#ifdef USE_THREADING
+  if (encoder.joinable())
+  {
+    encoder.join();
+  }
+#endif
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <filesystem>
+#include "../json/json.hpp"
+#include "../rayimage/Image.hpp"
+#include "Scene.hpp"
+#include "Camera.hpp"
+#include "Animation.hpp"
+
+/**
+ * Renders the frames of an animated scene file in one process: the scene
+ * (and its OBJ files) is loaded once, and each frame only transforms again
+ * the objects that moved.
+ *
+ * The PNG files of a frame are encoded while the next frame is rendered.
+ * When a frame is too small to keep all the render threads busy, several
+ * frames are rendered at once, one per thread, each by its own instance of
+ * the scene.
+ */
+class SequenceRenderer
+{
+private:
+  // One instance of the scene per frame rendered at the same time
+  struct Slot
+  {
+    Scene *scene = nullptr;
+    Camera *camera = nullptr;
+    Animation animation;
+    Image *image = nullptr;
+  };
+
+  std::vector<Slot> slots;
+  int frameCount = 1;
+
+  void loadSlot(nlohmann::json const &data, std::filesystem::path const &sceneDirectory);
+  void clear();
+
+public:
+  /**
+   * `concurrentFrames`: frames rendered at once (0 = automatic: one per render
+   * thread when a frame has too few tiles for all the threads, otherwise 1).
+   * Throws std::runtime_error (or a JSON exception) on an invalid scene.
+   */
+  SequenceRenderer(nlohmann::json const &data, std::filesystem::path const &sceneDirectory, int concurrentFrames = 1);
+  ~SequenceRenderer();
+  SequenceRenderer(SequenceRenderer const &) = delete;
+  SequenceRenderer &operator=(SequenceRenderer const &) = delete;
+
+  int getFrameCount() const { return frameCount; };
+  int getConcurrentFrames() const { return slots.size(); };
+
+  /**
+   * Renders the frames first to last (included) to the files named by `pattern`.
+   * Throws std::runtime_error when a frame cannot be rendered.
+   */
+  void render(int first, int last, std::string const &pattern);
+
+  /**
+   * File of a frame: `pattern` is a printf pattern with one integer
+   * (frame_%04d.png), or a file name to which _0000 is appended before the extension.
+   */
+  static std::string frameFileName(std::string const &pattern, int frame);
+};
@@ -80,7 +80,7 @@ bool Sphere::intersects(Ray &r, Intersection &intersection, CullingType culling)
 
   // Pre-calculate some useful values for rendering
   intersection.Position = P1;
-  intersection.Mat = this->material;
+  intersection.MaterialID = this->materialID;
   intersection.Normal = (P1 - center).normalize();
 
   // Junk function!!
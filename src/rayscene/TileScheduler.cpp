@@ -0,0 +1,196 @@
+#include <iostream>
+#include <algorithm>
+#include <cstdio>
+#include "TileScheduler.hpp"
+
+unsigned long TileScheduler::mortonIndex(unsigned int x, unsigned int y)
+{
+  // Interleave the bits of x and y
+  unsigned long index = 0;
+  for (unsigned int bit = 0; bit < 16; ++bit)
+  {
+    index |= (unsigned long)((x >> bit) & 1) << (2 * bit);
+    index |= (unsigned long)((y >> bit) & 1) << (2 * bit + 1);
+  }
+  return index;
+}
+
+unsigned long TileScheduler::hilbertIndex(unsigned int n, unsigned int x, unsigned int y)
+{
+  unsigned long index = 0;
+  for (unsigned int s = n / 2; s > 0; s /= 2)
+  {
+    unsigned int rx = (x & s) > 0;
+    unsigned int ry = (y & s) > 0;
+    index += (unsigned long)s * s * ((3 * rx) ^ ry);
+
+    // Rotate the quadrant
+    if (ry == 0)
+    {
+      if (rx == 1)
+      {
+        x = s - 1 - x;
+        y = s - 1 - y;
+      }
+      std::swap(x, y);
+    }
+  }
+  return index;
+}
+
+Tile TileScheduler::gridTile(int width, int height, int tileSize, int index)
+{
+  const int columns = (width + tileSize - 1) / tileSize;
+  int x = (index % columns) * tileSize;
+  int y = (index / columns) * tileSize;
+  return {x, y, std::min(x + tileSize, width), std::min(y + tileSize, height), index};
+}
+
+int TileScheduler::gridTileCount(int width, int height, int tileSize)
+{
+  return ((width + tileSize - 1) / tileSize) * ((height + tileSize - 1) / tileSize);
+}
+
+TileScheduler::TileScheduler(int width, int height, int tileSize, int workers, TileOrder order,
+                             std::function<bool(Tile const &)> const &filter)
+{
+  tileSize = std::max(tileSize, 1);
+  const int columns = (width + tileSize - 1) / tileSize;
+  const int rows = (height + tileSize - 1) / tileSize;
+
+  // The curves are defined on a power of 2 grid: the tiles outside the image are skipped
+  unsigned int gridSize = 1;
+  while (gridSize < (unsigned int)std::max(columns, rows))
+  {
+    gridSize *= 2;
+  }
+
+  std::vector<std::pair<unsigned long, Tile>> ordered;
+  for (int row = 0; row < rows; ++row)
+  {
+    for (int column = 0; column < columns; ++column)
+    {
+      Tile tile = gridTile(width, height, tileSize, row * columns + column);
+      if (filter && !filter(tile))
+      {
+        continue;
+      }
+
+      unsigned long key = (unsigned long)row * columns + column;
+      if (order == TILE_ORDER_MORTON)
+      {
+        key = mortonIndex(column, row);
+      }
+      else if (order == TILE_ORDER_HILBERT)
+      {
+        key = hilbertIndex(gridSize, column, row);
+      }
+      ordered.push_back({key, tile});
+    }
+  }
+
+  std::sort(ordered.begin(), ordered.end(), [](auto const &a, auto const &b)
+            { return a.first < b.first; });
+  for (auto &entry : ordered)
+  {
+    tiles.push_back(entry.second);
+  }
+
+  workers = std::max(workers, 1);
+  stats.resize(workers);
+  for (int i = 0; i < workers; ++i)
+  {
+    queues.push_back(std::make_unique<WorkerQueue>());
+  }
+
+  // Contiguous runs of tiles (along the chosen order): each worker starts in its own region of the image
+  const int tileCount = tiles.size();
+  for (int i = 0; i < tileCount; ++i)
+  {
+    int owner = (int)((long long)i * workers / tileCount);
+    queues[owner]->tiles.push_back(i);
+  }
+}
+
+TileScheduler::~TileScheduler()
+{
+}
+
+bool TileScheduler::popOwn(int worker, int &tileIndex)
+{
+  WorkerQueue &queue = *queues[worker];
+  std::lock_guard<std::mutex> guard(queue.lock);
+  if (queue.tiles.empty())
+  {
+    return false;
+  }
+  tileIndex = queue.tiles.front();
+  queue.tiles.pop_front();
+  return true;
+}
+
+bool TileScheduler::steal(int worker, int &tileIndex)
+{
+  const int workerCount = queues.size();
+  for (int i = 1; i < workerCount; ++i)
+  {
+    WorkerQueue &victim = *queues[(worker + i) % workerCount];
+    std::lock_guard<std::mutex> guard(victim.lock);
+    if (!victim.tiles.empty())
+    {
+      // Take from the far end: the victim keeps the tiles next to the one it is rendering
+      tileIndex = victim.tiles.back();
+      victim.tiles.pop_back();
+      return true;
+    }
+  }
+  return false;
+}
+
+bool TileScheduler::next(int worker, Tile &tile)
+{
+  int tileIndex;
+  if (popOwn(worker, tileIndex))
+  {
+    stats[worker].tiles++;
+  }
+  else if (steal(worker, tileIndex))
+  {
+    stats[worker].tiles++;
+    stats[worker].stolen++;
+  }
+  else
+  {
+    // No tile is ever added once rendering started: empty everywhere means done
+    return false;
+  }
+
+  tile = tiles[tileIndex];
+  return true;
+}
+
+void TileScheduler::addBusyTime(int worker, double seconds)
+{
+  stats[worker].busySeconds += seconds;
+}
+
+void TileScheduler::printStats(std::ostream &_stream) const
+{
+  const int workerCount = stats.size();
+  double total = 0;
+  double maximum = 0;
+  char line[128];
+
+  for (int i = 0; i < workerCount; ++i)
+  {
+    std::snprintf(line, sizeof(line), "  Thread %2d: busy %8.3f s, %5d tiles (%d stolen)",
+                  i, stats[i].busySeconds, stats[i].tiles, stats[i].stolen);
+    _stream << line << std::endl;
+    total += stats[i].busySeconds;
+    maximum = std::max(maximum, stats[i].busySeconds);
+  }
+
+  double average = total / workerCount;
+  std::snprintf(line, sizeof(line), "  Imbalance (max / average busy time): %.3f", average > 0 ? maximum / average : 1.0);
+  _stream << line << std::endl;
+}
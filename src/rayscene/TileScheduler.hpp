@@ -0,0 +1,102 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <memory>
+#include <functional>
+
+/**
+ * Rectangle of pixels [x0, x1[ x [y0, y1[ rendered as one unit of work.
+ */
+struct Tile
+{
+  int x0;
+  int y0;
+  int x1;
+  int y1;
+  // Row-major position in the grid of tiles (does not depend on the tile order)
+  int index;
+};
+
+/**
+ * Order in which the tiles are issued.
+ * Along a space-filling curve (Morton or Hilbert), consecutive tiles are
+ * close to each other in 2D, so a thread keeps working on the same part of
+ * the scene and its data stays in cache.
+ */
+enum TileOrder
+{
+  TILE_ORDER_SCANLINE, // Rows of tiles, top to bottom
+  TILE_ORDER_MORTON,   // Z-order curve
+  TILE_ORDER_HILBERT   // Hilbert curve (no jumps between consecutive tiles)
+};
+
+/**
+ * Per-worker counters, used to check the load balance.
+ */
+struct WorkerStats
+{
+  double busySeconds = 0;
+  int tiles = 0;
+  int stolen = 0;
+};
+
+/**
+ * Splits the image into small tiles and hands them out to the workers.
+ *
+ * Each worker owns a deque, initially filled with a contiguous run of tiles
+ * (neighbouring tiles touch the same scene data). A worker takes tiles from
+ * the front of its own deque; when it is empty, it steals from the back of
+ * the other workers' deques, so no worker idles while there is work left.
+ */
+class TileScheduler
+{
+private:
+  struct WorkerQueue
+  {
+    std::mutex lock;
+    std::deque<int> tiles;
+  };
+
+  std::vector<Tile> tiles;
+  std::vector<std::unique_ptr<WorkerQueue>> queues;
+  std::vector<WorkerStats> stats;
+
+  bool popOwn(int worker, int &tileIndex);
+  bool steal(int worker, int &tileIndex);
+
+public:
+  /**
+   * Only the tiles accepted by `filter` (if any) are handed out.
+   */
+  TileScheduler(int width, int height, int tileSize, int workers, TileOrder order = TILE_ORDER_SCANLINE,
+                std::function<bool(Tile const &)> const &filter = nullptr);
+  ~TileScheduler();
+
+  /**
+   * Gets the next tile for a worker. Returns false once all the tiles are taken.
+   */
+  bool next(int worker, Tile &tile);
+
+  // Adds the time spent by a worker on a tile to its statistics
+  void addBusyTime(int worker, double seconds);
+
+  int getWorkerCount() const { return queues.size(); };
+  int getTileCount() const { return tiles.size(); };
+  const WorkerStats &getStats(int worker) const { return stats[worker]; };
+
+  /**
+   * Prints the busy time of each worker and the imbalance (max / average busy time).
+   */
+  void printStats(std::ostream &_stream) const;
+
+  // Tile of the grid at a given row-major index
+  static Tile gridTile(int width, int height, int tileSize, int index);
+  static int gridTileCount(int width, int height, int tileSize);
+
+  // Position of tile (x, y) along the curve, in a grid of n x n tiles (n power of 2)
+  static unsigned long mortonIndex(unsigned int x, unsigned int y);
+  static unsigned long hilbertIndex(unsigned int n, unsigned int x, unsigned int y);
+};
@@ -33,6 +33,21 @@ void Triangle::calculateBoundingBox()
 }
 
 bool Triangle::intersects(Ray &r, Intersection &intersection, CullingType culling)
+{
+  // Thin dispatch from the runtime enum to the specialised kernels
+  switch (culling)
+  {
+  case CULLING_FRONT:
+    return intersectsCulled<CULLING_FRONT>(r, intersection);
+  case CULLING_BACK:
+    return intersectsCulled<CULLING_BACK>(r, intersection);
+  default:
+    return intersectsCulled<CULLING_BOTH>(r, intersection);
+  }
+}
+
+template <CullingType culling>
+bool Triangle::intersectsCulled(Ray &r, Intersection &intersection)
 {
   Vector3 BA = tB - tA;
   Vector3 CA = tC - tA;
@@ -44,6 +59,7 @@ bool Triangle::intersects(Ray &r, Intersection &intersection, CullingType cullin
   //
   // If denom == 0 - it is parallel to the plane
   // If denom > 0, it means plane is behind the ray
+  // (culling is a template parameter: the dead test is removed at compile time)
   if (culling == CULLING_FRONT && denom > -0.000001)
   {
     return false;
@@ -90,8 +106,12 @@ bool Triangle::intersects(Ray &r, Intersection &intersection, CullingType cullin
   }
 
   intersection.Position = Q;
-  intersection.Mat = this->material;
+  intersection.MaterialID = this->materialID;
   intersection.Normal = normal;
 
   return true;
-}
\ No newline at end of file
+}
+
+template bool Triangle::intersectsCulled<CULLING_FRONT>(Ray &r, Intersection &intersection);
+template bool Triangle::intersectsCulled<CULLING_BACK>(Ray &r, Intersection &intersection);
+template bool Triangle::intersectsCulled<CULLING_BOTH>(Ray &r, Intersection &intersection);
@@ -25,4 +25,12 @@ public:
   virtual void applyTransform() override;
   virtual void calculateBoundingBox() override;
   virtual bool intersects(Ray &r, Intersection &intersection, CullingType culling) override;
+
+  /**
+   * Intersection kernel specialised at compile time on the culling mode,
+   * so the culling test is resolved without a runtime branch.
+   * Called directly (non-virtual) by Mesh in its inner loop.
+   */
+  template <CullingType culling>
+  bool intersectsCulled(Ray &r, Intersection &intersection);
 };
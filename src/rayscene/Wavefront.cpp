@@ -0,0 +1,271 @@
+#include <algorithm>
+#include "Wavefront.hpp"
+#include "Scene.hpp"
+#include "Material.hpp"
+
+void RayQueue::clear()
+{
+  ox.clear();
+  oy.clear();
+  oz.clear();
+  dx.clear();
+  dy.clear();
+  dz.clear();
+  owner.clear();
+}
+
+void RayQueue::push(Ray const &ray, int rayOwner)
+{
+  Vector3 o = ray.GetPosition();
+  Vector3 d = ray.GetDirection();
+  ox.push_back(o.x);
+  oy.push_back(o.y);
+  oz.push_back(o.z);
+  dx.push_back(d.x);
+  dy.push_back(d.y);
+  dz.push_back(d.z);
+  owner.push_back(rayOwner);
+}
+
+Ray RayQueue::get(size_t i) const
+{
+  return Ray::normalized(Vector3(ox[i], oy[i], oz[i]), Vector3(dx[i], dy[i], dz[i]));
+}
+
+void RayQueue::reorder(std::vector<uint32_t> const &order)
+{
+  for (std::vector<double> *component : {&ox, &oy, &oz, &dx, &dy, &dz})
+  {
+    std::vector<double> sorted(order.size());
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+      sorted[i] = (*component)[order[i]];
+    }
+    component->swap(sorted);
+  }
+  std::vector<int> sorted(order.size());
+  for (size_t i = 0; i < order.size(); ++i)
+  {
+    sorted[i] = owner[order[i]];
+  }
+  owner.swap(sorted);
+}
+
+void HitQueue::clear()
+{
+  px.clear();
+  py.clear();
+  pz.clear();
+  nx.clear();
+  ny.clear();
+  nz.clear();
+  vx.clear();
+  vy.clear();
+  vz.clear();
+  materialID.clear();
+  ray.clear();
+}
+
+void HitQueue::push(Intersection const &hit, int hitRay)
+{
+  px.push_back(hit.Position.x);
+  py.push_back(hit.Position.y);
+  pz.push_back(hit.Position.z);
+  nx.push_back(hit.Normal.x);
+  ny.push_back(hit.Normal.y);
+  nz.push_back(hit.Normal.z);
+  vx.push_back(hit.View.x);
+  vy.push_back(hit.View.y);
+  vz.push_back(hit.View.z);
+  materialID.push_back(hit.MaterialID);
+  ray.push_back(hitRay);
+}
+
+Intersection HitQueue::get(size_t i) const
+{
+  Intersection hit;
+  hit.Position = Vector3(px[i], py[i], pz[i]);
+  hit.Normal = Vector3(nx[i], ny[i], nz[i]);
+  hit.View = Vector3(vx[i], vy[i], vz[i]);
+  hit.MaterialID = materialID[i];
+  return hit;
+}
+
+// Spreads the 10 low bits of v to every third bit
+static uint64_t spreadBits(uint64_t v)
+{
+  v &= 0x3ff;
+  v = (v | (v << 16)) & 0x30000ff;
+  v = (v | (v << 8)) & 0x300f00f;
+  v = (v | (v << 4)) & 0x30c30c3;
+  v = (v | (v << 2)) & 0x9249249;
+  return v;
+}
+
+void Wavefront::sortCoherent(RayQueue &queue)
+{
+  const size_t count = queue.size();
+  if (count < 2)
+  {
+    return;
+  }
+
+  double min[3] = {queue.ox[0], queue.oy[0], queue.oz[0]};
+  double max[3] = {min[0], min[1], min[2]};
+  for (size_t i = 1; i < count; ++i)
+  {
+    double o[3] = {queue.ox[i], queue.oy[i], queue.oz[i]};
+    for (int axis = 0; axis < 3; ++axis)
+    {
+      min[axis] = std::min(min[axis], o[axis]);
+      max[axis] = std::max(max[axis], o[axis]);
+    }
+  }
+  double scale[3];
+  for (int axis = 0; axis < 3; ++axis)
+  {
+    scale[axis] = max[axis] > min[axis] ? 1023.0 / (max[axis] - min[axis]) : 0;
+  }
+
+  keys.resize(count);
+  for (size_t i = 0; i < count; ++i)
+  {
+    uint64_t octant = (queue.dx[i] < 0) | (queue.dy[i] < 0) << 1 | (queue.dz[i] < 0) << 2;
+    uint64_t cx = (uint64_t)((queue.ox[i] - min[0]) * scale[0]);
+    uint64_t cy = (uint64_t)((queue.oy[i] - min[1]) * scale[1]);
+    uint64_t cz = (uint64_t)((queue.oz[i] - min[2]) * scale[2]);
+    uint64_t morton = spreadBits(cx) | spreadBits(cy) << 1 | spreadBits(cz) << 2;
+    keys[i] = {octant << 30 | morton, (uint32_t)i};
+  }
+  std::sort(keys.begin(), keys.end());
+
+  order.resize(count);
+  for (size_t i = 0; i < count; ++i)
+  {
+    order[i] = keys[i].second;
+  }
+  queue.reorder(order);
+}
+
+void Wavefront::trace(Scene &scene, RayQueue const &cameraRays, int maxCastCount, std::vector<Radiance> &radiance)
+{
+  const size_t paths = cameraRays.size();
+  rays.clear();
+  for (size_t i = 0; i < paths; ++i)
+  {
+    rays.push(cameraRays.get(i), i);
+  }
+  weight.assign(paths, 1);
+  emitted.resize(maxCastCount + 1);
+  reflection.resize(maxCastCount + 1);
+
+  int depth = 0;
+  for (; depth <= maxCastCount && rays.size() > 0; ++depth)
+  {
+    emitted[depth].assign(paths, Radiance());
+    reflection[depth].assign(paths, 0);
+
+    // Extend: closest hits
+    hits.clear();
+    tracedRays += rays.size();
+    for (size_t i = 0; i < rays.size(); ++i)
+    {
+      Ray ray = rays.get(i);
+      Intersection hit;
+      if (scene.closestIntersection(ray, hit, CULLING_FRONT) && hit.MaterialID != NO_MATERIAL)
+      {
+        // The view direction goes to the eye, the origin of the camera ray of the path
+        hit.View = (cameraRays.get(rays.owner[i]).GetPosition() - hit.Position).normalize();
+        hits.push(hit, i);
+      }
+    }
+
+    // Shadow: the rays of all the hits, then their any-hit queries
+    shadows.clear();
+    firstShadow.resize(hits.size());
+    for (size_t h = 0; h < hits.size(); ++h)
+    {
+      Intersection hit = hits.get(h);
+      firstShadow[h] = shadows.size();
+      scene.getMaterial(hit.MaterialID)->shadowRays(&hit, &scene, shadows, h);
+    }
+    blocked.resize(shadows.size());
+    tracedRays += shadows.size();
+    for (size_t s = 0; s < shadows.size(); ++s)
+    {
+      Ray shadow = shadows.get(s);
+      blocked[s] = scene.anyIntersection(shadow, CULLING_BACK);
+    }
+
+    // Shade, deferred: the hits grouped by material, one call per material
+    const size_t materialCount = scene.getMaterials().size();
+    shaded.resize(hits.size());
+    batches.resize(materialCount);
+    for (ShadingBatch &batch : batches)
+    {
+      batch.indices.clear();
+    }
+    for (size_t h = 0; h < hits.size(); ++h)
+    {
+      batches[hits.materialID[h]].indices.push_back(h);
+    }
+    for (size_t id = 0; id < materialCount; ++id)
+    {
+      ShadingBatch &batch = batches[id];
+      if (batch.indices.empty())
+      {
+        continue;
+      }
+      batch.scene = &scene;
+      batch.hits = &hits;
+      batch.rays = &rays;
+      batch.cameraRays = &cameraRays;
+      batch.blocked = blocked.data();
+      batch.firstShadow = firstShadow.data();
+      batch.radiance = shaded.data();
+      scene.getMaterial(id)->renderBatch(batch);
+    }
+
+    // Reflect
+    reflected.clear();
+    for (size_t h = 0; h < hits.size(); ++h)
+    {
+      const int path = rays.owner[hits.ray[h]];
+      Material *material = scene.getMaterial(hits.materialID[h]);
+      emitted[depth][path] = Radiance() + shaded[h];
+
+      if (depth < maxCastCount && material->cReflection > 0)
+      {
+        Vector3 normal(hits.nx[h], hits.ny[h], hits.nz[h]);
+        Vector3 position(hits.px[h], hits.py[h], hits.pz[h]);
+        Vector3 direction(rays.dx[hits.ray[h]], rays.dy[hits.ray[h]], rays.dz[hits.ray[h]]);
+        Vector3 reflectDir = direction.reflect(normal);
+        Vector3 origin = position + (reflectDir * COMPARE_ERROR_CONSTANT);
+        Ray reflectRay(origin, reflectDir);
+
+        float factor;
+        if (scene.traceReflection(reflectRay, weight[path], material->cReflection, factor))
+        {
+          reflected.push(reflectRay, path);
+          reflection[depth][path] = factor;
+          weight[path] = weight[path] * material->cReflection;
+        }
+      }
+    }
+    if (sortRays)
+    {
+      sortCoherent(reflected);
+    }
+    std::swap(rays, reflected);
+  }
+
+  // Fold the bounces back, deepest first: pixel = hit + reflected * factor
+  radiance.assign(paths, Radiance());
+  for (int k = depth - 1; k >= 0; --k)
+  {
+    for (size_t p = 0; p < paths; ++p)
+    {
+      radiance[p] = reflection[k][p] > 0 ? emitted[k][p] + radiance[p] * reflection[k][p] : emitted[k][p];
+    }
+  }
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include "../raymath/Ray.hpp"
+#include "../raymath/Radiance.hpp"
+#include "Intersection.hpp"
+
+class Scene;
+
+/**
+ * Rays stored component by component (structure of arrays), with the index of
+ * what each ray belongs to (a path, or a hit for shadow rays).
+ */
+struct RayQueue
+{
+  std::vector<double> ox, oy, oz;
+  std::vector<double> dx, dy, dz;
+  std::vector<int> owner;
+
+  size_t size() const { return owner.size(); };
+  void clear();
+  void push(Ray const &ray, int owner);
+  Ray get(size_t i) const;
+  // Puts the ray order[i] at index i
+  void reorder(std::vector<uint32_t> const &order);
+};
+
+/**
+ * Closest hits of a ray queue (structure of arrays): for each hit, the index of
+ * its ray in the queue.
+ */
+struct HitQueue
+{
+  std::vector<double> px, py, pz;
+  std::vector<double> nx, ny, nz;
+  std::vector<double> vx, vy, vz;
+  std::vector<int> materialID;
+  std::vector<int> ray;
+
+  size_t size() const { return ray.size(); };
+  void clear();
+  void push(Intersection const &hit, int ray);
+  Intersection get(size_t i) const;
+};
+
+/**
+ * Deferred shading: the hits of one material, shaded together by
+ * Material::renderBatch. Hits are indices in `hits`, results go to radiance[hit].
+ */
+struct ShadingBatch
+{
+  Scene *scene;
+  HitQueue const *hits;
+  // Ray of each hit (HitQueue::ray), and camera ray of each path (RayQueue::owner)
+  RayQueue const *rays;
+  RayQueue const *cameraRays;
+  // Shadow rays of the hit h: blocked[firstShadow[h]] onwards, in the order of Material::shadowRays
+  const char *blocked;
+  const size_t *firstShadow;
+  std::vector<uint32_t> indices;
+  Radiance *radiance;
+};
+
+/**
+ * Wavefront integrator: traces a batch of camera rays stage by stage instead of
+ * one recursive path at a time. Each bounce runs over the whole queue:
+ *  - extend: closest hit of every ray,
+ *  - shadow: the shadow rays of every hit, then their any-hit queries,
+ *  - shade: the material lighting of every hit, deferred: the hits are grouped
+ *    by material, and each material shades its whole group in one call,
+ *  - reflect: the reflected rays, queued for the next bounce (and optionally
+ *    sorted: rays leaving curved surfaces scatter in all directions).
+ * The bounces are then folded back from the deepest one, in the order of
+ * Scene::raycast: the radiance is bit-identical to the recursive integrator.
+ */
+class Wavefront
+{
+private:
+  RayQueue rays;
+  RayQueue reflected;
+  HitQueue hits;
+  RayQueue shadows;
+  std::vector<char> blocked;
+  std::vector<size_t> firstShadow;
+  // Deferred shading: the hits of each material, and their radiance
+  std::vector<ShadingBatch> batches;
+  std::vector<Radiance> shaded;
+
+  // Per bounce and per path: radiance of the hit, and the factor of the
+  // reflected radiance (0 when no reflected ray was traced)
+  std::vector<std::vector<Radiance>> emitted;
+  std::vector<std::vector<float>> reflection;
+  // Product of the reflectivities along each path (Scene::traceReflection)
+  std::vector<float> weight;
+
+  // Ray sorting: (key, index) of each ray, and the resulting order
+  std::vector<std::pair<uint64_t, uint32_t>> keys;
+  std::vector<uint32_t> order;
+
+  /**
+   * Reorders rays so that neighbours in the queue take similar paths through
+   * the scene: by direction octant, then along a Morton curve over the cells
+   * of a 1024^3 grid spanning the origins of the queue.
+   */
+  void sortCoherent(RayQueue &queue);
+
+public:
+  // Sort the reflected rays before tracing them (same radiance, other memory order)
+  bool sortRays = false;
+  // Closest-hit and any-hit queries traced since the creation
+  long tracedRays = 0;
+
+  /**
+   * Radiance of each camera ray of the queue (`radiance[i]` for the i-th ray),
+   * the same as scene.raycast(ray, ray, 0, maxCastCount).
+   */
+  void trace(Scene &scene, RayQueue const &cameraRays, int maxCastCount, std::vector<Radiance> &radiance);
+};
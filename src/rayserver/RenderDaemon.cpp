@@ -0,0 +1,255 @@
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <cstring>
+#include <cerrno>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "RenderDaemon.hpp"
+#include "../rayscene/SceneLoader.hpp"
+
+#ifdef USE_THREADING
+#include <thread>
+#endif
+
+using json = nlohmann::json;
+
+RenderDaemon::RenderDaemon(std::string socketPath, size_t cachedScenes, RenderCache *images)
+    : socketPath(socketPath), scenes(cachedScenes), images(images)
+{
+}
+
+json RenderDaemon::renderJob(json const &request)
+{
+  auto begin = std::chrono::steady_clock::now();
+
+  json data;
+  std::filesystem::path directory;
+  if (request.contains("scene"))
+  {
+    std::string path = request["scene"];
+    std::ifstream f(path);
+    if (!f.good())
+    {
+      throw std::runtime_error("Scene file not found at path: " + path);
+    }
+    data = json::parse(f);
+    directory = std::filesystem::path(path).parent_path();
+  }
+  else if (request.contains("sceneJson"))
+  {
+    data = request["sceneJson"];
+    directory = request.value("directory", ".");
+  }
+  else
+  {
+    throw std::runtime_error("a job needs a \"scene\" path or an inline \"sceneJson\"");
+  }
+  std::string output = request.value("output", "image.png");
+  json overrides = request.value("render", json::object());
+  if (!overrides.empty())
+  {
+    data["render"].merge_patch(overrides);
+  }
+
+  uint64_t contentHash = SceneLoader::Hash(data, directory);
+  // Tile subsets and time-limited renders are not whole deterministic images
+  bool cacheable = images != nullptr && SceneLoader::RendersAllTiles(data) &&
+                   (!data.contains("render") || data["render"].value("timeBudget", 0.0) <= 0);
+  if (cacheable && images->fetch(contentHash, output))
+  {
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+    return {{"ok", true}, {"output", output}, {"imageCached", true}, {"totalSeconds", elapsed.count()}};
+  }
+
+  bool cached;
+  Scene *scene = scenes.get(data, directory, cached);
+  auto [camera, image] = SceneLoader::LoadView(data);
+  scene->contentHash = contentHash;
+
+  auto renderBegin = std::chrono::steady_clock::now();
+  try
+  {
+    camera->render(*image, *scene);
+  }
+  catch (...)
+  {
+    delete camera;
+    delete image;
+    throw;
+  }
+  auto renderEnd = std::chrono::steady_clock::now();
+  image->writeFile(output);
+  if (cacheable)
+  {
+    images->store(contentHash, output);
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  json answer = {{"ok", true}, {"output", output}, {"width", image->width}, {"height", image->height}, {"sceneCached", cached}, {"imageCached", false}};
+  answer["renderSeconds"] = std::chrono::duration<double>(renderEnd - renderBegin).count();
+  answer["totalSeconds"] = std::chrono::duration<double>(end - begin).count();
+  delete camera;
+  delete image;
+  return answer;
+}
+
+json RenderDaemon::handle(json const &request)
+{
+  std::lock_guard<std::mutex> guard(requestLock);
+  try
+  {
+    std::string command = request.value("command", "render");
+    if (command == "shutdown")
+    {
+      stopping = true;
+      // Wakes up accept()
+      if (listener >= 0)
+      {
+        shutdown(listener, SHUT_RDWR);
+      }
+      return {{"ok", true}};
+    }
+    if (command == "stats")
+    {
+      json stats = {{"ok", true}, {"jobs", jobs}, {"cachedScenes", scenes.size()}, {"sceneHits", scenes.getHits()}, {"sceneMisses", scenes.getMisses()}};
+      if (images != nullptr)
+      {
+        stats["imageHits"] = images->getHits();
+        stats["imageMisses"] = images->getMisses();
+      }
+      return stats;
+    }
+    if (command == "render")
+    {
+      jobs++;
+      return renderJob(request);
+    }
+    throw std::runtime_error("unknown command: " + command);
+  }
+  catch (std::exception const &e)
+  {
+    // A bad request must not stop the daemon
+    return {{"ok", false}, {"error", e.what()}};
+  }
+}
+
+void RenderDaemon::serveConnection(int connection)
+{
+  std::string pending;
+  char buffer[4096];
+
+  while (!stopping)
+  {
+    ssize_t received = read(connection, buffer, sizeof(buffer));
+    if (received <= 0)
+    {
+      return;
+    }
+    pending.append(buffer, received);
+
+    size_t newline;
+    while (!stopping && (newline = pending.find('\n')) != std::string::npos)
+    {
+      std::string line = pending.substr(0, newline);
+      pending.erase(0, newline + 1);
+      if (line.find_first_not_of(" \t\r") == std::string::npos)
+      {
+        continue;
+      }
+
+      json request = json::parse(line, nullptr, false);
+      json answer = request.is_discarded() ? json({{"ok", false}, {"error", "invalid JSON request"}}) : handle(request);
+      std::string reply = answer.dump() + "\n";
+
+      // MSG_NOSIGNAL: a client gone away must not kill the daemon (SIGPIPE)
+      for (size_t sent = 0; sent < reply.size();)
+      {
+        ssize_t n = send(connection, reply.data() + sent, reply.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0)
+        {
+          return;
+        }
+        sent += n;
+      }
+    }
+  }
+}
+
+bool RenderDaemon::run()
+{
+  sockaddr_un address = {};
+  address.sun_family = AF_UNIX;
+  if (socketPath.size() >= sizeof(address.sun_path))
+  {
+    std::cerr << "[ERROR] socket path too long: " << socketPath << std::endl;
+    return false;
+  }
+  std::strcpy(address.sun_path, socketPath.c_str());
+
+  listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  unlink(socketPath.c_str());
+  if (listener < 0 || bind(listener, (sockaddr *)&address, sizeof(address)) != 0 || listen(listener, 16) != 0)
+  {
+    std::cerr << "[ERROR] cannot listen on " << socketPath << ": " << std::strerror(errno) << std::endl;
+    if (listener >= 0)
+    {
+      close(listener);
+      listener = -1;
+    }
+    return false;
+  }
+
+  std::cout << "Listening on " << socketPath << std::endl;
+  while (!stopping)
+  {
+    int connection = accept(listener, nullptr, nullptr);
+    if (connection < 0)
+    {
+      continue;
+    }
+#ifdef USE_THREADING
+    std::lock_guard<std::mutex> guard(connectionsLock);
+    connections.insert(connection);
+    std::thread([this, connection]
+                {
+                  serveConnection(connection);
+                  std::lock_guard<std::mutex> guard(connectionsLock);
+                  connections.erase(connection);
+                  close(connection);
+                  allClosed.notify_all(); })
+        .detach();
+#else
+    serveConnection(connection);
+    close(connection);
+#endif
+  }
+
+#ifdef USE_THREADING
+  {
+    // The clients still connected stop being read: their threads end
+    std::unique_lock<std::mutex> guard(connectionsLock);
+    for (int connection : connections)
+    {
+      shutdown(connection, SHUT_RD);
+    }
+    allClosed.wait(guard, [&]
+                   { return connections.empty(); });
+  }
+#endif
+
+  {
+    std::lock_guard<std::mutex> guard(requestLock);
+    close(listener);
+    listener = -1;
+  }
+  unlink(socketPath.c_str());
+  std::cout << "Daemon stopped after " << jobs << " jobs (" << scenes.getHits() << " scene cache hits, "
+            << scenes.getMisses() << " misses)" << std::endl;
+  if (images != nullptr)
+  {
+    images->printStats(std::cout);
+  }
+  return true;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <string>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <set>
+#include "../json/json.hpp"
+#include "../rayscene/SceneCache.hpp"
+#include "../rayscene/RenderCache.hpp"
+
+/**
+ * Resident renderer serving requests on a Unix socket: the loaded scenes
+ * (prepared geometry included) and the thread pool are kept between
+ * requests, so a request only costs its render and PNG encoding.
+ *
+ * One JSON request per line, answered by one JSON line:
+ *   {"scene": "scenes/all.json", "output": "all.png", "render": {"threads": 4}}
+ *   {"sceneJson": {...}, "directory": "scenes", "output": "all.png"}
+ *   {"command": "stats"}
+ *   {"command": "shutdown"}
+ * "render" overrides the render settings of the scene, like the command line
+ * options. "directory" is where the OBJ files of an inline scene are looked up.
+ * Answers: {"ok": true, ...} or {"ok": false, "error": "..."}.
+ * A job identical to a previous one is answered from the image cache, if any.
+ * Each connection is served by its own thread (an idle client does not hold
+ * the others up), the requests are handled one at a time.
+ */
+class RenderDaemon
+{
+private:
+  std::string socketPath;
+  SceneCache scenes;
+  RenderCache *images;
+  long jobs = 0;
+  std::atomic<bool> stopping{false};
+  int listener = -1;
+
+  // One request at a time: the caches and the cached scenes are shared
+  std::mutex requestLock;
+  // Open connections, closed by their thread
+  std::mutex connectionsLock;
+  std::condition_variable allClosed;
+  std::set<int> connections;
+
+  nlohmann::json renderJob(nlohmann::json const &request);
+  void serveConnection(int connection);
+
+public:
+  /**
+   * `cachedScenes`: number of scenes kept in memory.
+   * `images`: cache of finished images (optional), checked before rendering.
+   */
+  RenderDaemon(std::string socketPath, size_t cachedScenes = 8, RenderCache *images = nullptr);
+
+  nlohmann::json handle(nlohmann::json const &request);
+
+  /**
+   * Serves the connections until a shutdown request.
+   * Returns false if the socket cannot be created.
+   */
+  bool run();
+};
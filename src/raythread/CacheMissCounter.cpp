@@ -0,0 +1,47 @@
+#include <cstdint>
+#include <cstring>
+#include "CacheMissCounter.hpp"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+CacheMissCounter::CacheMissCounter()
+{
+#ifdef __linux__
+  perf_event_attr attr;
+  std::memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.config = PERF_COUNT_HW_CACHE_MISSES;
+  // User space only: allowed with the default perf_event_paranoid setting
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  // This thread, on any CPU
+  fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+}
+
+CacheMissCounter::~CacheMissCounter()
+{
+#ifdef __linux__
+  if (fd >= 0)
+  {
+    close(fd);
+  }
+#endif
+}
+
+long CacheMissCounter::read() const
+{
+#ifdef __linux__
+  uint64_t count = 0;
+  if (fd >= 0 && ::read(fd, &count, sizeof(count)) == sizeof(count))
+  {
+    return (long)count;
+  }
+#endif
+  return 0;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+/**
+ * Hardware cache misses of the calling thread (Linux perf_event_open).
+ *
+ * Not available outside Linux, or when the kernel or the container forbids
+ * performance counters (perf_event_paranoid, seccomp, virtual machines without
+ * a PMU): available() is then false and read() returns 0.
+ */
+class CacheMissCounter
+{
+private:
+  int fd = -1;
+
+public:
+  // Starts counting
+  CacheMissCounter();
+  ~CacheMissCounter();
+  CacheMissCounter(CacheMissCounter const &) = delete;
+  CacheMissCounter &operator=(CacheMissCounter const &) = delete;
+
+  bool available() const { return fd >= 0; };
+  // Misses since the counter was started
+  long read() const;
+};
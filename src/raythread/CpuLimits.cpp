@@ -0,0 +1,195 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <cmath>
+#include <algorithm>
+#include "CpuLimits.hpp"
+
+#ifdef USE_THREADING
+#include <thread>
+#endif
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+/**
+ * Reads the quota of a cgroup v2 directory ("cpu.max": "<quota> <period>" or "max <period>").
+ * Returns the quota in CPUs, or 0 if there is none.
+ */
+static double readQuotaV2(std::string const &dir)
+{
+  std::ifstream f(dir + "/cpu.max");
+  std::string quota;
+  double period = 0;
+  if (!(f >> quota >> period) || quota == "max" || period <= 0)
+  {
+    return 0;
+  }
+  return std::stod(quota) / period;
+}
+
+/**
+ * Reads the quota of a cgroup v1 directory (cpu.cfs_quota_us is -1 when unlimited).
+ */
+static double readQuotaV1(std::string const &dir)
+{
+  std::ifstream fQuota(dir + "/cpu.cfs_quota_us");
+  std::ifstream fPeriod(dir + "/cpu.cfs_period_us");
+  double quota = 0;
+  double period = 0;
+  if (!(fQuota >> quota) || !(fPeriod >> period) || quota <= 0 || period <= 0)
+  {
+    return 0;
+  }
+  return quota / period;
+}
+
+/**
+ * Limits are inherited: the effective quota is the smallest one
+ * between the cgroup of the process and the root of the hierarchy.
+ */
+static double readQuotaHierarchy(std::string const &mount, std::string path, bool v2)
+{
+  double quota = 0;
+  while (true)
+  {
+    double q = v2 ? readQuotaV2(mount + path) : readQuotaV1(mount + path);
+    if (q > 0 && (quota == 0 || q < quota))
+    {
+      quota = q;
+    }
+
+    if (path.empty() || path == "/")
+    {
+      break;
+    }
+    size_t slash = path.find_last_of('/');
+    path = (slash == std::string::npos || slash == 0) ? "/" : path.substr(0, slash);
+  }
+  return quota;
+}
+
+static double detectCgroupQuota()
+{
+  // Lines of /proc/self/cgroup: "<id>:<controllers>:<path>", cgroup v2 is "0::<path>"
+  std::ifstream f("/proc/self/cgroup");
+  std::string line;
+  double quota = 0;
+
+  while (std::getline(f, line))
+  {
+    size_t first = line.find(':');
+    size_t second = line.find(':', first + 1);
+    if (first == std::string::npos || second == std::string::npos)
+    {
+      continue;
+    }
+    std::string controllers = line.substr(first + 1, second - first - 1);
+    std::string path = line.substr(second + 1);
+
+    double q = 0;
+    if (controllers.empty())
+    {
+      q = readQuotaHierarchy("/sys/fs/cgroup", path, true);
+    }
+    else
+    {
+      std::stringstream list(controllers);
+      std::string controller;
+      while (std::getline(list, controller, ','))
+      {
+        if (controller == "cpu")
+        {
+          q = readQuotaHierarchy("/sys/fs/cgroup/cpu", path, false);
+          if (q == 0)
+          {
+            q = readQuotaHierarchy("/sys/fs/cgroup/cpu,cpuacct", path, false);
+          }
+        }
+      }
+    }
+
+    if (q > 0 && (quota == 0 || q < quota))
+    {
+      quota = q;
+    }
+  }
+
+  return quota;
+}
+
+CpuLimits CpuLimits::detect()
+{
+  CpuLimits limits;
+
+#ifdef USE_THREADING
+  limits.hardware = std::thread::hardware_concurrency();
+#else
+  limits.hardware = 1;
+#endif
+
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (sched_getaffinity(0, sizeof(set), &set) == 0)
+  {
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+    {
+      if (CPU_ISSET(cpu, &set))
+      {
+        limits.cpus.push_back(cpu);
+      }
+    }
+    limits.affinity = limits.cpus.size();
+  }
+#endif
+
+  double quota = detectCgroupQuota();
+  if (quota > 0)
+  {
+    limits.quota = std::max(1, (int)std::ceil(quota));
+  }
+
+  return limits;
+}
+
+int CpuLimits::recommendedThreads() const
+{
+  int threads = hardware;
+  if (affinity > 0 && (threads == 0 || affinity < threads))
+  {
+    threads = affinity;
+  }
+  if (quota > 0 && (threads == 0 || quota < threads))
+  {
+    threads = quota;
+  }
+  // Fallback to 4 threads if nothing could be detected
+  return threads > 0 ? threads : 4;
+}
+
+std::ostream &operator<<(std::ostream &_stream, CpuLimits const &limits)
+{
+  _stream << "hardware: " << limits.hardware;
+  _stream << ", affinity: ";
+  if (limits.affinity > 0)
+  {
+    _stream << limits.affinity;
+  }
+  else
+  {
+    _stream << "unknown";
+  }
+  _stream << ", cgroup quota: ";
+  if (limits.quota > 0)
+  {
+    _stream << limits.quota;
+  }
+  else
+  {
+    _stream << "none";
+  }
+  return _stream;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+
+/**
+ * CPU resources really available to the process.
+ *
+ * std::thread::hardware_concurrency() reports the cores of the host,
+ * but in a container the process is usually limited by a cgroup CPU quota
+ * and/or a scheduler affinity mask: using more threads than that only adds
+ * contention.
+ */
+struct CpuLimits
+{
+  // Cores reported by the hardware (std::thread::hardware_concurrency)
+  int hardware = 0;
+  // CPUs of the sched affinity mask of the process (0 if unknown)
+  int affinity = 0;
+  // cgroup v1/v2 CPU quota, in CPUs, rounded up (0 if unlimited or unknown)
+  int quota = 0;
+  // IDs of the CPUs the process may run on (used to pin worker threads)
+  std::vector<int> cpus;
+
+  /**
+   * Number of worker threads to use: the smallest of the known limits.
+   */
+  int recommendedThreads() const;
+
+  static CpuLimits detect();
+
+  friend std::ostream &operator<<(std::ostream &_stream, CpuLimits const &limits);
+};
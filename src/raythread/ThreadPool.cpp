@@ -0,0 +1,217 @@
+#include <iostream>
+#include <atomic>
+#include <algorithm>
+#include "ThreadPool.hpp"
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// Set while a thread executes a job: nested jobs then run inline
+static thread_local bool insideJob = false;
+
+ThreadPool::ThreadPool(int workers, std::vector<int> const &pinCpus) : workerCount(std::max(workers, 1))
+{
+#ifdef USE_THREADING
+  for (int i = 1; i < workerCount; ++i)
+  {
+    threads.push_back(std::thread(&ThreadPool::workerLoop, this, i));
+
+#ifdef __linux__
+    if (!pinCpus.empty())
+    {
+      cpu_set_t set;
+      CPU_ZERO(&set);
+      CPU_SET(pinCpus[i % pinCpus.size()], &set);
+      pthread_setaffinity_np(threads.back().native_handle(), sizeof(set), &set);
+    }
+#endif
+  }
+#else
+  workerCount = 1;
+#endif
+}
+
+ThreadPool::~ThreadPool()
+{
+#ifdef USE_THREADING
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    stopping = true;
+  }
+  wakeUp.notify_all();
+
+  for (auto &thread : threads)
+  {
+    thread.join();
+  }
+#endif
+}
+
+void ThreadPool::workerLoop(int worker)
+{
+  unsigned long seen = 0;
+
+  while (true)
+  {
+    std::unique_lock<std::mutex> guard(lock);
+    // Parked here between jobs
+    wakeUp.wait(guard, [&]
+                { return stopping || generation != seen; });
+    if (stopping)
+    {
+      return;
+    }
+    seen = generation;
+    const std::function<void(int)> *current = job;
+    guard.unlock();
+
+    insideJob = true;
+    (*current)(worker);
+    insideJob = false;
+
+    guard.lock();
+    if (--pending == 0)
+    {
+      finished.notify_one();
+    }
+  }
+}
+
+void ThreadPool::run(std::function<void(int)> const &work)
+{
+  if (insideJob || workerCount == 1)
+  {
+    work(0);
+    return;
+  }
+
+  std::lock_guard<std::mutex> running(runLock);
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    job = &work;
+    pending = workerCount - 1;
+    generation++;
+  }
+  wakeUp.notify_all();
+
+  insideJob = true;
+  work(0);
+  insideJob = false;
+
+  std::unique_lock<std::mutex> guard(lock);
+  finished.wait(guard, [&]
+                { return pending == 0; });
+  job = nullptr;
+}
+
+bool ThreadPool::inJob()
+{
+  return insideJob;
+}
+
+void ThreadPool::parallelFor(int begin, int end, int grain, std::function<void(int)> const &body)
+{
+  if (end <= begin)
+  {
+    return;
+  }
+  grain = std::max(grain, 1);
+
+  // Small loops are not worth waking the workers up
+  if (end - begin <= grain)
+  {
+    for (int i = begin; i < end; ++i)
+    {
+      body(i);
+    }
+    return;
+  }
+
+  std::atomic<int> next(begin);
+  run([&](int worker)
+      {
+        while (true)
+        {
+          int chunkBegin = next.fetch_add(grain);
+          if (chunkBegin >= end)
+          {
+            return;
+          }
+          int chunkEnd = std::min(chunkBegin + grain, end);
+          for (int i = chunkBegin; i < chunkEnd; ++i)
+          {
+            body(i);
+          }
+        } });
+}
+
+// Settings of the shared pool
+static int sharedWorkers = 0;
+static bool sharedPinned = false;
+// Never destroyed: the parked workers of the current pool simply end with the process
+static std::shared_ptr<ThreadPool> &sharedPool = *new std::shared_ptr<ThreadPool>();
+static std::mutex sharedLock;
+
+#ifdef __linux__
+// fork(): only the forking thread exists in the child, not the workers of the
+// inherited pool. The child drops that pool without joining them (it is leaked)
+// and creates its own on first use.
+static void lockSharedPool()
+{
+  sharedLock.lock();
+}
+
+static void unlockSharedPool()
+{
+  sharedLock.unlock();
+}
+
+static void resetSharedPoolInChild()
+{
+  new std::shared_ptr<ThreadPool>(std::move(sharedPool));
+  sharedLock.unlock();
+}
+
+static const int forkHandlers = pthread_atfork(lockSharedPool, unlockSharedPool, resetSharedPoolInChild);
+#endif
+
+static std::shared_ptr<ThreadPool> createSharedPool()
+{
+  CpuLimits limits = CpuLimits::detect();
+  int workers = sharedWorkers > 0 ? sharedWorkers : limits.recommendedThreads();
+
+#ifdef USE_THREADING
+  std::cout << "Threads: " << workers << " (" << limits << ")" << std::endl;
+#endif
+
+  return std::make_shared<ThreadPool>(workers, sharedPinned ? limits.cpus : std::vector<int>());
+}
+
+std::shared_ptr<ThreadPool> ThreadPool::shared()
+{
+  std::lock_guard<std::mutex> guard(sharedLock);
+  if (sharedPool == nullptr)
+  {
+    sharedPool = createSharedPool();
+  }
+  return sharedPool;
+}
+
+void ThreadPool::configure(int workers, bool pinThreads)
+{
+  std::lock_guard<std::mutex> guard(sharedLock);
+  if (workers == sharedWorkers && pinThreads == sharedPinned)
+  {
+    return;
+  }
+
+  sharedWorkers = workers;
+  sharedPinned = pinThreads;
+  if (sharedPool != nullptr)
+  {
+    // Still used by the renders holding it: destroyed by the last one
+    sharedPool = createSharedPool();
+  }
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include "CpuLimits.hpp"
+
+#ifdef USE_THREADING
+#include <thread>
+#endif
+
+/**
+ * Long-lived pool of worker threads.
+ *
+ * The threads are created once and parked on a condition variable between
+ * jobs, so rendering many frames (or preparing a scene, or encoding an image)
+ * does not pay for creating and joining threads every time.
+ *
+ * The calling thread takes part in every job as worker 0.
+ * A job started from inside a job (nested call) runs inline on the calling worker.
+ */
+class ThreadPool
+{
+private:
+  std::mutex lock;
+  std::condition_variable wakeUp;
+  std::condition_variable finished;
+  // Only one job at a time
+  std::mutex runLock;
+
+  const std::function<void(int)> *job = nullptr;
+  unsigned long generation = 0;
+  int pending = 0;
+  bool stopping = false;
+  int workerCount = 1;
+
+#ifdef USE_THREADING
+  std::vector<std::thread> threads;
+#endif
+
+  void workerLoop(int worker);
+
+public:
+  /**
+   * Creates a pool of `workers` workers (the calling thread being one of them).
+   * If `pinCpus` is not empty, worker i is pinned to the CPU pinCpus[i % size]
+   * (the calling thread itself is never pinned).
+   */
+  ThreadPool(int workers, std::vector<int> const &pinCpus = std::vector<int>());
+  ~ThreadPool();
+
+  /**
+   * Runs job(worker) once on every worker, returns when all of them are done.
+   */
+  void run(std::function<void(int)> const &job);
+
+  /**
+   * Runs body(i) for every i in [begin, end[, handing out chunks of `grain`
+   * indices to the workers as they become free.
+   */
+  void parallelFor(int begin, int end, int grain, std::function<void(int)> const &body);
+
+  int size() const { return workerCount; };
+
+  // True on a thread running a job: a job it starts runs inline, on this thread only
+  static bool inJob();
+
+  /**
+   * Pool shared by the whole renderer, created on first use.
+   * Its size is the one given to configure(), or by default the number of
+   * CPUs the process may really use (cgroup quota, affinity mask).
+   * The pool stays alive while the caller holds it, even if configure()
+   * replaces it in the meantime.
+   * A child process created by fork() starts with a new pool.
+   */
+  static std::shared_ptr<ThreadPool> shared();
+
+  /**
+   * Sets the size of the shared pool (0 = automatic) and whether its workers
+   * are pinned to cores. The pool is replaced if it exists with other settings:
+   * the previous one ends when the jobs running on it are done and released it.
+   */
+  static void configure(int workers, bool pinThreads);
+};
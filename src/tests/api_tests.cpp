@@ -0,0 +1,198 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include "../rayapi/raytracer.h"
+#include "../lodepng/lodepng.h"
+
+// ============================================================================
+// Interface C de la bibliothèque : rendu dans un buffer de l'appelant,
+// identique au rendu en ligne de commande, sans fichier PNG intermédiaire
+// ============================================================================
+TEST(RaytracerAPI, RenderFromMemoryMatchesCommandLineRender)
+{
+    const std::string scene_path = "/app/scenes/two-triangles-on-plane.json";
+    const std::string golden_path = "/app/src/tests/reference/two_triangles_clamped.png";
+
+    std::ifstream file(scene_path);
+    std::stringstream scene_json;
+    scene_json << file.rdbuf();
+
+    rt_renderer *renderer = rt_create();
+    ASSERT_NE(renderer, nullptr);
+    ASSERT_EQ(rt_load_json(renderer, scene_json.str().c_str(), "/app/scenes"), 0) << rt_last_error(renderer);
+
+    int width, height;
+    ASSERT_EQ(rt_get_size(renderer, &width, &height), 0);
+    std::vector<unsigned char> pixels((size_t)width * height * 4);
+    ASSERT_EQ(rt_render_rgba8(renderer, pixels.data(), 0), 0) << rt_last_error(renderer);
+
+    // Second render of the same scene, with other options: the scene is reused
+    ASSERT_EQ(rt_set_render_options(renderer, "{\"tileOrder\": \"scanline\"}"), 0) << rt_last_error(renderer);
+    std::vector<unsigned char> again(pixels.size());
+    ASSERT_EQ(rt_render_rgba8(renderer, again.data(), 0), 0) << rt_last_error(renderer);
+
+    rt_stats stats;
+    ASSERT_EQ(rt_get_stats(renderer, &stats), 0);
+    EXPECT_EQ(stats.primary_rays, (long)width * height);
+
+    std::vector<unsigned char> golden;
+    unsigned gold_w, gold_h;
+    ASSERT_EQ(lodepng::decode(golden, gold_w, gold_h, golden_path), 0u);
+    ASSERT_EQ((unsigned)width, gold_w);
+    ASSERT_EQ((unsigned)height, gold_h);
+    EXPECT_TRUE(pixels == golden);
+    EXPECT_TRUE(again == golden);
+
+    // Errors are reported, not thrown
+    EXPECT_EQ(rt_load_json(renderer, "{ not json", nullptr), -1);
+    EXPECT_STRNE(rt_last_error(renderer), "");
+
+    // A scene whose camera is invalid is not loaded: the previous one is still rendered
+    const std::string bad_camera = "{\"camera\": {\"fov\": 400}, " + scene_json.str().substr(scene_json.str().find('{') + 1);
+    EXPECT_EQ(rt_load_json(renderer, bad_camera.c_str(), "/app/scenes"), -1);
+    std::vector<unsigned char> after_error(pixels.size());
+    ASSERT_EQ(rt_render_rgba8(renderer, after_error.data(), 0), 0) << rt_last_error(renderer);
+    EXPECT_TRUE(after_error == golden);
+
+    rt_renderer *empty = rt_create();
+    EXPECT_EQ(rt_load_json(empty, bad_camera.c_str(), "/app/scenes"), -1);
+    EXPECT_EQ(rt_render_rgba8(empty, after_error.data(), 0), -1);
+    rt_destroy(empty);
+
+    rt_destroy(renderer);
+}
+
+// ============================================================================
+// Deux moteurs qui rendent en même temps, avec des nombres de threads
+// différents : le pool partagé n'est pas détruit pendant qu'un rendu l'utilise
+// ============================================================================
+TEST(RaytracerAPI, ConcurrentRenderersWithOtherThreadCounts)
+{
+    const std::string scene_path = "/app/scenes/two-triangles-on-plane.json";
+    const std::string golden_path = "/app/src/tests/reference/two_triangles_clamped.png";
+
+    std::vector<unsigned char> golden;
+    unsigned gold_w, gold_h;
+    ASSERT_EQ(lodepng::decode(golden, gold_w, gold_h, golden_path), 0u);
+
+    bool same[2] = {false, false};
+    auto renderLoop = [&](int index)
+    {
+        rt_renderer *renderer = rt_create();
+        std::string options = "{\"threads\": " + std::to_string(index + 1) + "}";
+        bool ok = rt_load_file(renderer, scene_path.c_str()) == 0 && rt_set_render_options(renderer, options.c_str()) == 0;
+        std::vector<unsigned char> pixels((size_t)gold_w * gold_h * 4);
+        for (int i = 0; i < 3 && ok; ++i)
+        {
+            ok = rt_render_rgba8(renderer, pixels.data(), 0) == 0 && pixels == golden;
+        }
+        same[index] = ok;
+        rt_destroy(renderer);
+    };
+    std::thread first(renderLoop, 0);
+    std::thread second(renderLoop, 1);
+    first.join();
+    second.join();
+
+    EXPECT_TRUE(same[0]);
+    EXPECT_TRUE(same[1]);
+}
+
+// ============================================================================
+// Rééclairage : après un déplacement de la lumière, l'image ré-ombrée depuis
+// le G-buffer est identique à un rendu complet avec le nouvel éclairage
+// ============================================================================
+TEST(RaytracerAPI, RelightMatchesFullRenderAfterLightEdit)
+{
+    const std::string scene_path = "/app/scenes/two-triangles-on-plane.json";
+
+    rt_renderer *renderer = rt_create();
+    ASSERT_NE(renderer, nullptr);
+    ASSERT_EQ(rt_load_file(renderer, scene_path.c_str()), 0) << rt_last_error(renderer);
+
+    int width, height;
+    ASSERT_EQ(rt_get_size(renderer, &width, &height), 0);
+    std::vector<unsigned char> before((size_t)width * height * 4);
+    ASSERT_EQ(rt_relight_rgba8(renderer, before.data(), 0), 0) << rt_last_error(renderer);
+
+    const char *lights = "[{\"type\": \"point\", \"position\": {\"x\": 2, \"y\": 2, \"z\": 1},"
+                         " \"diffuse\": {\"r\": 0.6, \"g\": 0.4, \"b\": 0.2}, \"specular\": {\"r\": 1, \"g\": 1, \"b\": 1}}]";
+    ASSERT_EQ(rt_set_lights(renderer, lights), 0) << rt_last_error(renderer);
+
+    std::vector<unsigned char> relit(before.size());
+    ASSERT_EQ(rt_relight_rgba8(renderer, relit.data(), 0), 0) << rt_last_error(renderer);
+    rt_stats stats;
+    ASSERT_EQ(rt_get_stats(renderer, &stats), 0);
+    // No camera ray traced again
+    EXPECT_EQ(stats.primary_rays, 0);
+
+    std::vector<unsigned char> full(before.size());
+    ASSERT_EQ(rt_render_rgba8(renderer, full.data(), 0), 0) << rt_last_error(renderer);
+
+    EXPECT_TRUE(relit == full);
+    EXPECT_FALSE(relit == before);
+
+    // A malformed edit fails and keeps the current lights
+    const char *malformed = "[{\"type\": \"point\", \"position\": {\"x\": 0, \"y\": 1, \"z\": 0}},"
+                            " {\"type\": \"point\", \"position\": {\"x\": \"left\", \"y\": 1, \"z\": 0}}]";
+    EXPECT_EQ(rt_set_lights(renderer, malformed), -1);
+    std::vector<unsigned char> kept(before.size());
+    ASSERT_EQ(rt_relight_rgba8(renderer, kept.data(), 0), 0) << rt_last_error(renderer);
+    EXPECT_TRUE(kept == full);
+
+    EXPECT_EQ(rt_set_materials(renderer, "{\"unknown\": {\"type\": \"phong\"}}"), -1);
+
+    rt_destroy(renderer);
+}
+
+// ============================================================================
+// Édition d'un matériau nommé : seuls les objets qui l'utilisent changent,
+// même si un autre matériau nommé (ou un matériau en ligne) lui est identique
+// ============================================================================
+std::string namedMaterialsScene(std::string const &left)
+{
+    const std::string grey = "{\"type\": \"phong\", \"ambient\": {\"r\": 0.5, \"g\": 0.5, \"b\": 0.5},"
+                             " \"diffuse\": {\"r\": 1, \"g\": 1, \"b\": 1}, \"specular\": {\"r\": 1, \"g\": 1, \"b\": 1}, \"shininess\": 40}";
+    return "{\"image\": {\"width\": 160, \"height\": 90}, \"reflections\": 0,"
+           " \"ambient\": {\"r\": 1, \"g\": 1, \"b\": 1},"
+           " \"lights\": [{\"type\": \"point\", \"position\": {\"x\": -2, \"y\": 1, \"z\": 0},"
+           " \"diffuse\": {\"r\": 0.2, \"g\": 0.2, \"b\": 0.2}, \"specular\": {\"r\": 0.5, \"g\": 0.5, \"b\": 0.5}}],"
+           " \"materials\": {\"left\": " + (left.empty() ? grey : left) + ", \"right\": " + grey + "},"
+           " \"objects\": ["
+           " {\"type\": \"sphere\", \"radius\": 0.5, \"position\": {\"x\": -1, \"y\": 0, \"z\": 5}, \"material\": \"left\"},"
+           " {\"type\": \"sphere\", \"radius\": 0.5, \"position\": {\"x\": 1, \"y\": 0, \"z\": 5}, \"material\": \"right\"},"
+           " {\"type\": \"plane\", \"position\": {\"x\": 0, \"y\": -1, \"z\": 0}, \"normal\": {\"x\": 0, \"y\": 1, \"z\": 0},"
+           " \"material\": " + grey + "}]}";
+}
+
+TEST(RaytracerAPI, MaterialEditOnlyChangesItsObjects)
+{
+    const std::string red = "{\"type\": \"phong\", \"ambient\": {\"r\": 1, \"g\": 0, \"b\": 0},"
+                            " \"diffuse\": {\"r\": 1, \"g\": 1, \"b\": 1}, \"specular\": {\"r\": 1, \"g\": 1, \"b\": 1}, \"shininess\": 40}";
+
+    rt_renderer *renderer = rt_create();
+    ASSERT_NE(renderer, nullptr);
+    ASSERT_EQ(rt_load_json(renderer, namedMaterialsScene("").c_str(), nullptr), 0) << rt_last_error(renderer);
+
+    int width, height;
+    ASSERT_EQ(rt_get_size(renderer, &width, &height), 0);
+    std::vector<unsigned char> before((size_t)width * height * 4);
+    ASSERT_EQ(rt_relight_rgba8(renderer, before.data(), 0), 0) << rt_last_error(renderer);
+
+    ASSERT_EQ(rt_set_materials(renderer, ("{\"left\": " + red + "}").c_str()), 0) << rt_last_error(renderer);
+    std::vector<unsigned char> relit(before.size());
+    ASSERT_EQ(rt_relight_rgba8(renderer, relit.data(), 0), 0) << rt_last_error(renderer);
+
+    // The scene written with the red material from the start
+    ASSERT_EQ(rt_load_json(renderer, namedMaterialsScene(red).c_str(), nullptr), 0) << rt_last_error(renderer);
+    std::vector<unsigned char> expected(before.size());
+    ASSERT_EQ(rt_render_rgba8(renderer, expected.data(), 0), 0) << rt_last_error(renderer);
+
+    EXPECT_FALSE(relit == before);
+    EXPECT_TRUE(relit == expected);
+
+    rt_destroy(renderer);
+}
@@ -5,14 +5,24 @@
 #include <iostream>
 #include <fstream>
 #include <chrono>
+#include <filesystem>
+#include <thread>
+#include <cstring>
+#include <iterator>
+#include <random>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
 #include "../lodepng/lodepng.h"
+#include "../rayscene/LightGrid.hpp"
 
 // turn the RAYTRACER_EXECUTABLE definition from CMake into a string
 #define STRINGIFY(x) #x
 #define TOSTRING(x) STRINGIFY(x)
 
 // helper function to run the raytracer executable and return execution time
-double runRaytracer(const std::string &scenePath, const std::string &outputPath, bool expectSuccess = true)
+double runRaytracer(const std::string &scenePath, const std::string &outputPath, bool expectSuccess = true, const std::string &options = "")
 {
     std::string executable_path = TOSTRING(RAYTRACER_EXECUTABLE);
     // Remove quotes if present
@@ -22,6 +32,10 @@ double runRaytracer(const std::string &scenePath, const std::string &outputPath,
     }
 
     std::string command = executable_path + " " + scenePath + " " + outputPath;
+    if (!options.empty())
+    {
+        command += " " + options;
+    }
     std::cout << "Executing command: " << command << std::endl;
 
     auto start = std::chrono::high_resolution_clock::now();
@@ -308,4 +322,837 @@ TEST(RaytracerE2E, PerformanceMetrics_ComplexScene)
     EXPECT_GT(total_pixels, 0);
 
     std::cout << "=== TEST 4 RÉUSSI : Métriques affichées ===" << std::endl;
-}
\ No newline at end of file
+}
+// ============================================================================
+// TEST 5 : Accumulation HDR non bornée
+// ============================================================================
+// The golden image was rendered by the previous pipeline, which clamped the
+// color after every operation. The scene never saturates, so clamping once
+// at output must give exactly the same pixels.
+TEST(RaytracerE2E, UnclampedAccumulation_MatchesClampedOnNonSaturatingScene)
+{
+    const std::string scene_path = "/app/scenes/two-triangles-on-plane.json";
+    const std::string output_path = "test_unclamped.png";
+    const std::string golden_path = "/app/src/tests/reference/two_triangles_clamped.png";
+
+    std::cout << "\n=== TEST 5 : Accumulation HDR non bornée ===" << std::endl;
+
+    runRaytracer(scene_path, output_path);
+
+    std::vector<unsigned char> generated_image;
+    unsigned gen_w, gen_h;
+    ASSERT_TRUE(loadImage(output_path, generated_image, gen_w, gen_h));
+
+    std::vector<unsigned char> golden_image;
+    unsigned gold_w, gold_h;
+    ASSERT_TRUE(loadImage(golden_path, golden_image, gold_w, gold_h));
+
+    double rmse = calculate_rmse(generated_image, gen_w, gen_h, golden_image, gold_w, gold_h);
+    std::cout << " RMSE : " << rmse << std::endl;
+
+    EXPECT_EQ(rmse, 0.0);
+    std::cout << "=== TEST 5 RÉUSSI ===" << std::endl;
+}
+
+// ============================================================================
+// TEST 6 : Rendu progressif avec budget de temps
+// ============================================================================
+// Even with a budget too small for anything but the coarse pass, the image
+// must be complete: every pixel is covered by an upsampled coarse sample.
+TEST(RaytracerE2E, ProgressiveRendering_TinyBudgetGivesCompleteImage)
+{
+    const std::string scene_path = "/app/scenes/two-triangles-on-plane.json";
+    const std::string output_path = "test_progressive.png";
+    const std::string golden_path = "/app/src/tests/reference/two_triangles_clamped.png";
+
+    std::cout << "\n=== TEST 6 : Rendu progressif ===" << std::endl;
+
+    double exec_time = runRaytracer(scene_path, output_path, true, "--time-budget 0.001");
+    std::cout << "Temps d'exécution : " << exec_time << " secondes" << std::endl;
+
+    std::vector<unsigned char> generated_image;
+    unsigned gen_w, gen_h;
+    ASSERT_TRUE(loadImage(output_path, generated_image, gen_w, gen_h));
+
+    std::vector<unsigned char> golden_image;
+    unsigned gold_w, gold_h;
+    ASSERT_TRUE(loadImage(golden_path, golden_image, gold_w, gold_h));
+
+    // Coarse (1/8) approximation of the full render: close, but not identical
+    double rmse = calculate_rmse(generated_image, gen_w, gen_h, golden_image, gold_w, gold_h);
+    std::cout << " RMSE : " << rmse << std::endl;
+
+    EXPECT_LT(rmse, 25.0);
+    std::cout << "=== TEST 6 RÉUSSI ===" << std::endl;
+}
+
+// ============================================================================
+// TEST 7 : Reprise depuis un checkpoint
+// Un rendu repris depuis un checkpoint incomplet (processus interrompu)
+// doit donner exactement la même image qu'un rendu complet
+// ============================================================================
+TEST(RaytracerE2E, Checkpoint_ResumeFromPartialCheckpointMatchesFullRender)
+{
+    const std::string scene_path = "/app/scenes/two-triangles-on-plane.json";
+    const std::string checkpoint_path = "test_checkpoint.bin";
+    const std::string full_path = "test_checkpoint_full.png";
+    const std::string resumed_path = "test_checkpoint_resumed.png";
+
+    std::cout << "\n=== TEST 7 : Reprise depuis un checkpoint ===" << std::endl;
+
+    runRaytracer(scene_path, full_path, true, "--checkpoint " + checkpoint_path + " --checkpoint-interval 0");
+
+    // Simulate a render killed part way: keep the first third of the file, cutting a tile record
+    auto size = std::filesystem::file_size(checkpoint_path);
+    std::filesystem::resize_file(checkpoint_path, size / 3);
+
+    runRaytracer(scene_path, resumed_path, true, "--checkpoint " + checkpoint_path + " --resume");
+
+    std::vector<unsigned char> full_image;
+    unsigned full_w, full_h;
+    ASSERT_TRUE(loadImage(full_path, full_image, full_w, full_h));
+
+    std::vector<unsigned char> resumed_image;
+    unsigned resumed_w, resumed_h;
+    ASSERT_TRUE(loadImage(resumed_path, resumed_image, resumed_w, resumed_h));
+
+    double rmse = calculate_rmse(resumed_image, resumed_w, resumed_h, full_image, full_w, full_h);
+    std::cout << " RMSE : " << rmse << std::endl;
+
+    EXPECT_EQ(rmse, 0.0);
+    std::cout << "=== TEST 7 RÉUSSI ===" << std::endl;
+}
+
+// ============================================================================
+// TEST 8 : Rendu d'une région recadrée
+// Les pixels d'une région rendue seule (--crop) doivent être ceux de la même
+// région dans le rendu complet (même projection de la caméra)
+// ============================================================================
+TEST(RaytracerE2E, RegionRendering_CropMatchesFullRender)
+{
+    const std::string scene_path = "/app/scenes/two-triangles-on-plane.json";
+    const std::string output_path = "test_region_crop.png";
+    const std::string golden_path = "/app/src/tests/reference/two_triangles_clamped.png";
+    const unsigned x0 = 500, y0 = 300, w = 300, h = 200;
+
+    std::cout << "\n=== TEST 8 : Rendu d'une région ===" << std::endl;
+
+    runRaytracer(scene_path, output_path, true, "--region 500,300,300,200 --crop");
+
+    std::vector<unsigned char> crop_image;
+    unsigned crop_w, crop_h;
+    ASSERT_TRUE(loadImage(output_path, crop_image, crop_w, crop_h));
+    ASSERT_EQ(crop_w, w);
+    ASSERT_EQ(crop_h, h);
+
+    std::vector<unsigned char> golden_image;
+    unsigned gold_w, gold_h;
+    ASSERT_TRUE(loadImage(golden_path, golden_image, gold_w, gold_h));
+
+    // Same region cut out of the full render
+    std::vector<unsigned char> golden_region;
+    for (unsigned y = y0; y < y0 + h; ++y)
+    {
+        auto row = golden_image.begin() + ((size_t)y * gold_w + x0) * 4;
+        golden_region.insert(golden_region.end(), row, row + w * 4);
+    }
+
+    double rmse = calculate_rmse(crop_image, crop_w, crop_h, golden_region, w, h);
+    std::cout << " RMSE : " << rmse << std::endl;
+
+    EXPECT_EQ(rmse, 0.0);
+    std::cout << "=== TEST 8 RÉUSSI ===" << std::endl;
+}
+
+// ============================================================================
+// TEST 9 : Rendu réparti entre plusieurs processus
+// L'image assemblée à partir des parties rendues par des processus séparés
+// doit être identique au rendu en un seul processus, avec ou sans --tiles
+// ============================================================================
+TEST(RaytracerE2E, DistributedRendering_MergedPartsMatchFullRender)
+{
+    const std::string scene_path = "/app/scenes/two-triangles-on-plane.json";
+    const std::string output_path = "test_distributed.png";
+    const std::string golden_path = "/app/src/tests/reference/two_triangles_clamped.png";
+
+    std::cout << "\n=== TEST 9 : Rendu réparti ===" << std::endl;
+
+    runRaytracer(scene_path, output_path, true, "--processes 3");
+
+    std::vector<unsigned char> generated_image;
+    unsigned gen_w, gen_h;
+    ASSERT_TRUE(loadImage(output_path, generated_image, gen_w, gen_h));
+
+    std::vector<unsigned char> golden_image;
+    unsigned gold_w, gold_h;
+    ASSERT_TRUE(loadImage(golden_path, golden_image, gold_w, gold_h));
+
+    double rmse = calculate_rmse(generated_image, gen_w, gen_h, golden_image, gold_w, gold_h);
+    std::cout << " RMSE : " << rmse << std::endl;
+
+    EXPECT_EQ(rmse, 0.0);
+
+    // Restreint à une partie des tuiles : les processus se partagent ces tuiles seulement
+    runRaytracer(scene_path, "test_distributed_tiles.png", true, "--tiles 3-40:2 --processes 3");
+    runRaytracer(scene_path, "test_distributed_tiles_single.png", true, "--tiles 3-40:2");
+
+    std::vector<unsigned char> tiles_image, single_image;
+    unsigned tiles_w, tiles_h, single_w, single_h;
+    ASSERT_TRUE(loadImage("test_distributed_tiles.png", tiles_image, tiles_w, tiles_h));
+    ASSERT_TRUE(loadImage("test_distributed_tiles_single.png", single_image, single_w, single_h));
+
+    double rmse_tiles = calculate_rmse(tiles_image, tiles_w, tiles_h, single_image, single_w, single_h);
+    std::cout << " RMSE avec --tiles : " << rmse_tiles << std::endl;
+
+    EXPECT_EQ(rmse_tiles, 0.0);
+    std::cout << "=== TEST 9 RÉUSSI ===" << std::endl;
+}
+
+// helper function to send one request line to the render daemon and read the answer line
+std::string daemonRequest(int connection, const std::string &request)
+{
+    std::string line = request + "\n";
+    EXPECT_EQ(write(connection, line.data(), line.size()), (ssize_t)line.size());
+
+    std::string answer;
+    char c;
+    while (read(connection, &c, 1) == 1 && c != '\n')
+    {
+        answer += c;
+    }
+    std::cout << " -> " << answer << std::endl;
+    return answer;
+}
+
+// helper function to connect to the render daemon, waiting for it to listen
+int connectDaemon(const std::string &socket_path)
+{
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    std::strcpy(address.sun_path, socket_path.c_str());
+    int connection = socket(AF_UNIX, SOCK_STREAM, 0);
+    for (int attempt = 0; attempt < 100; ++attempt)
+    {
+        if (connect(connection, (sockaddr *)&address, sizeof(address)) == 0)
+        {
+            return connection;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    close(connection);
+    return -1;
+}
+
+// ============================================================================
+// TEST 10 : Démon de rendu
+// Le démon garde la scène en mémoire : la deuxième requête sur la même scène
+// utilise le cache, et l'image est identique au rendu en ligne de commande
+// ============================================================================
+TEST(RaytracerE2E, Daemon_SecondJobReusesCachedScene)
+{
+    const std::string socket_path = "/tmp/raytracer_test.sock";
+    const std::string output_path = "test_daemon.png";
+    const std::string golden_path = "/app/src/tests/reference/two_triangles_clamped.png";
+    const std::string job = "{\"scene\": \"/app/scenes/two-triangles-on-plane.json\", \"output\": \"" + output_path + "\"}";
+
+    std::cout << "\n=== TEST 10 : Démon de rendu ===" << std::endl;
+
+    std::string executable_path = TOSTRING(RAYTRACER_EXECUTABLE);
+    std::system((executable_path + " --daemon " + socket_path + " > /dev/null &").c_str());
+
+    int connection = connectDaemon(socket_path);
+    ASSERT_GE(connection, 0) << "Le démon n'a pas ouvert " << socket_path;
+
+    std::string first = daemonRequest(connection, job);
+    std::string second = daemonRequest(connection, job);
+    std::string invalid = daemonRequest(connection, "{\"scene\": \"/app/scenes/nonexistent_file.json\"}");
+    daemonRequest(connection, "{\"command\": \"shutdown\"}");
+    close(connection);
+
+    EXPECT_NE(first.find("\"sceneCached\":false"), std::string::npos);
+    EXPECT_NE(second.find("\"sceneCached\":true"), std::string::npos);
+    EXPECT_NE(invalid.find("\"ok\":false"), std::string::npos);
+
+    std::vector<unsigned char> generated_image;
+    unsigned gen_w, gen_h;
+    ASSERT_TRUE(loadImage(output_path, generated_image, gen_w, gen_h));
+
+    std::vector<unsigned char> golden_image;
+    unsigned gold_w, gold_h;
+    ASSERT_TRUE(loadImage(golden_path, golden_image, gold_w, gold_h));
+
+    double rmse = calculate_rmse(generated_image, gen_w, gen_h, golden_image, gold_w, gold_h);
+    std::cout << " RMSE : " << rmse << std::endl;
+
+    EXPECT_EQ(rmse, 0.0);
+    std::cout << "=== TEST 10 RÉUSSI ===" << std::endl;
+}
+
+// ============================================================================
+// TEST 11 : Cache des images rendues
+// Le deuxième rendu identique (au nombre de threads près) est servi par le
+// cache : un succès, un échec, et la même image
+// ============================================================================
+TEST(RaytracerE2E, RenderCache_IdenticalJobIsServedFromCache)
+{
+    const std::string scene_path = "/app/scenes/two-triangles-on-plane.json";
+    const std::string cache_dir = "test_render_cache";
+    const std::string first_path = "test_cache_first.png";
+    const std::string second_path = "test_cache_second.png";
+
+    std::cout << "\n=== TEST 11 : Cache des images ===" << std::endl;
+
+    std::filesystem::remove_all(cache_dir);
+    runRaytracer(scene_path, first_path, true, "--cache " + cache_dir);
+    // The number of threads does not change the image: same cache entry
+    runRaytracer(scene_path, second_path, true, "--cache " + cache_dir + " --threads 2");
+
+    long hits = -1, misses = -1;
+    std::ifstream counters(cache_dir + "/counters");
+    counters >> hits >> misses;
+    EXPECT_EQ(hits, 1);
+    EXPECT_EQ(misses, 1);
+
+    std::vector<unsigned char> first_image, second_image;
+    unsigned w1, h1, w2, h2;
+    ASSERT_TRUE(loadImage(first_path, first_image, w1, h1));
+    ASSERT_TRUE(loadImage(second_path, second_image, w2, h2));
+
+    double rmse = calculate_rmse(first_image, w1, h1, second_image, w2, h2);
+    std::cout << " RMSE : " << rmse << std::endl;
+
+    EXPECT_EQ(rmse, 0.0);
+    std::cout << "=== TEST 11 RÉUSSI ===" << std::endl;
+}
+
+// ============================================================================
+// TEST 12 : Séquence d'images animée
+// Les images rendues ensemble (un processus, plusieurs images à la fois) sont
+// les mêmes qu'en séquence, et l'image 0 est la pose de la scène sans animation
+// ============================================================================
+TEST(RaytracerE2E, Animation_SequenceFramesMatchSingleRenders)
+{
+    const std::string scene_path = "/app/scenes/two-triangles-turntable.json";
+    const std::string golden_path = "/app/src/tests/reference/two_triangles_clamped.png";
+
+    std::cout << "\n=== TEST 12 : Séquence animée ===" << std::endl;
+
+    runRaytracer(scene_path, "test_sequence_%02d.png", true, "--frames 0-2 --threads 2 --concurrent-frames 2");
+    runRaytracer(scene_path, "test_sequence_single.png", true, "--frames 2-2");
+
+    std::vector<unsigned char> frames[3];
+    unsigned w[3], h[3];
+    for (int i = 0; i < 3; ++i)
+    {
+        ASSERT_TRUE(loadImage("test_sequence_0" + std::to_string(i) + ".png", frames[i], w[i], h[i]));
+    }
+
+    std::vector<unsigned char> golden_image, single_image;
+    unsigned gold_w, gold_h, single_w, single_h;
+    ASSERT_TRUE(loadImage(golden_path, golden_image, gold_w, gold_h));
+    ASSERT_TRUE(loadImage("test_sequence_single_0002.png", single_image, single_w, single_h));
+
+    double rmse_first = calculate_rmse(frames[0], w[0], h[0], golden_image, gold_w, gold_h);
+    double rmse_moved = calculate_rmse(frames[1], w[1], h[1], golden_image, gold_w, gold_h);
+    double rmse_single = calculate_rmse(frames[2], w[2], h[2], single_image, single_w, single_h);
+    std::cout << " RMSE image 0 : " << rmse_first << ", image 1 : " << rmse_moved << ", image 2 : " << rmse_single << std::endl;
+
+    EXPECT_EQ(rmse_first, 0.0);
+    EXPECT_GT(rmse_moved, 0.0);
+    EXPECT_EQ(rmse_single, 0.0);
+    std::cout << "=== TEST 12 RÉUSSI ===" << std::endl;
+}
+
+// ============================================================================
+// TEST 13 : Rendu incrémental
+// Après le déplacement d'une sphère, le rendu des seules tuiles touchées (sur
+// l'image de la version précédente) donne la même image qu'un rendu complet
+// ============================================================================
+std::string twoSpheresScene(double x)
+{
+    return R"({
+    "image": { "width": 320, "height": 180 },
+    "reflections": 0,
+    "ambient": { "r": 1, "g": 1, "b": 1 },
+    "lights": [ { "type": "point", "position": { "x": -2, "y": 1, "z": 0 },
+                  "diffuse": { "r": 0.2, "g": 0.2, "b": 0.2 }, "specular": { "r": 0.5, "g": 0.5, "b": 0.5 } } ],
+    "objects": [
+        { "type": "sphere", "radius": 0.5, "position": { "x": )" + std::to_string(x) + R"(, "y": 0, "z": 5 },
+          "material": { "type": "phong", "ambient": { "r": 1, "g": 0, "b": 0 }, "diffuse": { "r": 1, "g": 1, "b": 1 },
+                        "specular": { "r": 1, "g": 1, "b": 1 }, "shininess": 40 } },
+        { "type": "sphere", "radius": 0.5, "position": { "x": 1, "y": 0, "z": 6 },
+          "material": { "type": "phong", "ambient": { "r": 0, "g": 0, "b": 1 }, "diffuse": { "r": 1, "g": 1, "b": 1 },
+                        "specular": { "r": 1, "g": 1, "b": 1 }, "shininess": 40 } },
+        { "type": "plane", "position": { "x": 0, "y": -1, "z": 0 }, "normal": { "x": 0, "y": 1, "z": 0 },
+          "material": { "type": "phong", "ambient": { "r": 0.2, "g": 0.2, "b": 0.2 }, "diffuse": { "r": 1, "g": 1, "b": 1 },
+                        "specular": { "r": 0, "g": 0, "b": 0 }, "shininess": 1 } }
+    ]
+})";
+}
+
+TEST(RaytracerE2E, IncrementalRender_MatchesFullRender)
+{
+    const std::string before_path = "test_incremental_before.json";
+    const std::string after_path = "test_incremental_after.json";
+    const std::string incremental_path = "test_incremental.png";
+    const std::string full_path = "test_incremental_full.png";
+
+    std::cout << "\n=== TEST 13 : Rendu incrémental ===" << std::endl;
+
+    std::ofstream(before_path) << twoSpheresScene(-1.5);
+    std::ofstream(after_path) << twoSpheresScene(-1.2);
+
+    runRaytracer(before_path, incremental_path);
+    runRaytracer(after_path, incremental_path, true, "--update-from " + before_path);
+    runRaytracer(after_path, full_path);
+
+    std::vector<unsigned char> incremental_image, full_image;
+    unsigned inc_w, inc_h, full_w, full_h;
+    ASSERT_TRUE(loadImage(incremental_path, incremental_image, inc_w, inc_h));
+    ASSERT_TRUE(loadImage(full_path, full_image, full_w, full_h));
+
+    double rmse = calculate_rmse(incremental_image, inc_w, inc_h, full_image, full_w, full_h);
+    std::cout << " RMSE : " << rmse << std::endl;
+
+    EXPECT_EQ(rmse, 0.0);
+    std::cout << "=== TEST 13 RÉUSSI ===" << std::endl;
+}
+
+// ============================================================================
+// TEST 14 : Intégrateur wavefront
+// Les rayons tracés par étapes (intersections, ombres, shading, réflexions)
+// donnent exactement l'image de l'intégrateur récursif, réflexions comprises,
+// que les rayons réfléchis soient triés ou non
+// ============================================================================
+TEST(RaytracerE2E, WavefrontIntegrator_MatchesRecursive)
+{
+    const std::string scene_path = "/app/scenes/two-spheres-on-plane.json";
+    const std::string recursive_path = "test_integrator_recursive.png";
+    const std::string wavefront_path = "test_integrator_wavefront.png";
+    const std::string sorted_path = "test_integrator_sorted.png";
+
+    std::cout << "\n=== TEST 14 : Intégrateur wavefront ===" << std::endl;
+
+    runRaytracer(scene_path, recursive_path, true, "--integrator recursive");
+    runRaytracer(scene_path, wavefront_path, true, "--integrator wavefront --threads 2");
+    runRaytracer(scene_path, sorted_path, true, "--integrator wavefront --sort-rays");
+
+    std::vector<unsigned char> recursive_image, wavefront_image, sorted_image;
+    unsigned rec_w, rec_h, wave_w, wave_h, sort_w, sort_h;
+    ASSERT_TRUE(loadImage(recursive_path, recursive_image, rec_w, rec_h));
+    ASSERT_TRUE(loadImage(wavefront_path, wavefront_image, wave_w, wave_h));
+    ASSERT_TRUE(loadImage(sorted_path, sorted_image, sort_w, sort_h));
+
+    double rmse = calculate_rmse(recursive_image, rec_w, rec_h, wavefront_image, wave_w, wave_h);
+    double rmse_sorted = calculate_rmse(recursive_image, rec_w, rec_h, sorted_image, sort_w, sort_h);
+    std::cout << " RMSE : " << rmse << ", rayons triés : " << rmse_sorted << std::endl;
+
+    EXPECT_EQ(rmse, 0.0);
+    EXPECT_EQ(rmse_sorted, 0.0);
+    std::cout << "=== TEST 14 RÉUSSI ===" << std::endl;
+}
+
+// ============================================================================
+// TEST 15 : Arrêt des chemins de réflexion
+// Les réflexions de poids trop faible ne sont plus tracées : l'image change,
+// mais reste la même avec les deux intégrateurs, roulette russe comprise
+// ============================================================================
+TEST(RaytracerE2E, ReflectionTermination_SameForBothIntegrators)
+{
+    const std::string scene_path = "/app/scenes/two-spheres-on-plane.json";
+    const std::string full_path = "test_termination_full.png";
+
+    std::cout << "\n=== TEST 15 : Arrêt des réflexions ===" << std::endl;
+
+    std::ifstream scene_file(scene_path);
+    std::string scene((std::istreambuf_iterator<char>(scene_file)), std::istreambuf_iterator<char>());
+    runRaytracer(scene_path, full_path);
+
+    std::vector<unsigned char> full_image;
+    unsigned full_w, full_h;
+    ASSERT_TRUE(loadImage(full_path, full_image, full_w, full_h));
+
+    for (std::string roulette : {"false", "true"})
+    {
+        // The second bounce (weight 0.25) is below the threshold
+        const std::string terminated_path = "test_termination_" + roulette + ".json";
+        std::ofstream(terminated_path) << "{\"reflectionTermination\": {\"threshold\": 0.3, \"russianRoulette\": " + roulette + "}, " +
+                                              scene.substr(scene.find('{') + 1);
+        runRaytracer(terminated_path, "test_termination_recursive.png", true, "--integrator recursive");
+        runRaytracer(terminated_path, "test_termination_wavefront.png", true, "--integrator wavefront");
+
+        std::vector<unsigned char> recursive_image, wavefront_image;
+        unsigned rec_w, rec_h, wave_w, wave_h;
+        ASSERT_TRUE(loadImage("test_termination_recursive.png", recursive_image, rec_w, rec_h));
+        ASSERT_TRUE(loadImage("test_termination_wavefront.png", wavefront_image, wave_w, wave_h));
+
+        double rmse = calculate_rmse(recursive_image, rec_w, rec_h, wavefront_image, wave_w, wave_h);
+        double rmse_full = calculate_rmse(recursive_image, rec_w, rec_h, full_image, full_w, full_h);
+        std::cout << " Roulette " << roulette << " - RMSE entre intégrateurs : " << rmse << ", avec toutes les réflexions : " << rmse_full << std::endl;
+
+        EXPECT_EQ(rmse, 0.0);
+        EXPECT_GT(rmse_full, 0.0);
+    }
+    std::cout << "=== TEST 15 RÉUSSI ===" << std::endl;
+}
+
+// ============================================================================
+// TEST 16 : Échantillonnage des lumières
+// Avec beaucoup de lumières, chaque point n'est éclairé que par quelques
+// lumières tirées dans l'arbre des lumières : l'image change, mais reste la
+// même avec les deux intégrateurs. Sans assez de lumières, rien ne change
+// ============================================================================
+std::string manyLightsScene(int samples)
+{
+    // A 10 x 10 grid of dim lights above the spheres
+    std::string lights;
+    for (int i = 0; i < 100; ++i)
+    {
+        lights += std::string(i ? ", " : "") + R"({ "type": "point", "position": { "x": )" + std::to_string(-4.5 + i % 10) +
+                  R"(, "y": 1.5, "z": )" + std::to_string(1 + i / 10) + R"( },
+                  "diffuse": { "r": 0.02, "g": 0.02, "b": 0.02 }, "specular": { "r": 0.02, "g": 0.02, "b": 0.02 } })";
+    }
+    std::string scene = twoSpheresScene(-1.5);
+    size_t begin = scene.find("\"lights\"");
+    size_t end = scene.find("\"objects\"");
+    return scene.substr(0, begin) + "\"lightSampling\": { \"samples\": " + std::to_string(samples) + " },\n    \"lights\": [ " + lights +
+           " ],\n    " + scene.substr(end);
+}
+
+TEST(RaytracerE2E, LightSampling_SameForBothIntegrators)
+{
+    std::cout << "\n=== TEST 16 : Échantillonnage des lumières ===" << std::endl;
+
+    std::ofstream("test_lights_all.json") << manyLightsScene(0);
+    std::ofstream("test_lights_100.json") << manyLightsScene(100);
+    std::ofstream("test_lights_8.json") << manyLightsScene(8);
+
+    runRaytracer("test_lights_all.json", "test_lights_all.png");
+    runRaytracer("test_lights_100.json", "test_lights_100.png");
+    runRaytracer("test_lights_8.json", "test_lights_recursive.png", true, "--integrator recursive");
+    runRaytracer("test_lights_8.json", "test_lights_wavefront.png", true, "--integrator wavefront");
+
+    std::vector<unsigned char> all_image, hundred_image, recursive_image, wavefront_image;
+    unsigned all_w, all_h, hundred_w, hundred_h, rec_w, rec_h, wave_w, wave_h;
+    ASSERT_TRUE(loadImage("test_lights_all.png", all_image, all_w, all_h));
+    ASSERT_TRUE(loadImage("test_lights_100.png", hundred_image, hundred_w, hundred_h));
+    ASSERT_TRUE(loadImage("test_lights_recursive.png", recursive_image, rec_w, rec_h));
+    ASSERT_TRUE(loadImage("test_lights_wavefront.png", wavefront_image, wave_w, wave_h));
+
+    double rmse_all = calculate_rmse(hundred_image, hundred_w, hundred_h, all_image, all_w, all_h);
+    double rmse = calculate_rmse(recursive_image, rec_w, rec_h, wavefront_image, wave_w, wave_h);
+    double rmse_sampled = calculate_rmse(recursive_image, rec_w, rec_h, all_image, all_w, all_h);
+    std::cout << " RMSE 100 échantillons / toutes les lumières : " << rmse_all << ", entre intégrateurs : " << rmse
+              << ", 8 échantillons / toutes les lumières : " << rmse_sampled << std::endl;
+
+    EXPECT_EQ(rmse_all, 0.0);
+    EXPECT_EQ(rmse, 0.0);
+    EXPECT_GT(rmse_sampled, 0.0);
+    std::cout << "=== TEST 16 RÉUSSI ===" << std::endl;
+}
+
+// ============================================================================
+// TEST 17 : Rayon d'influence des lumières
+// Une lumière qui n'atteint aucun objet ne change pas l'image, et les
+// lumières triées dans la grille donnent la même image avec les deux
+// intégrateurs
+// ============================================================================
+TEST(RaytracerE2E, LightRadius_OnlyReachingLightsShade)
+{
+    std::cout << "\n=== TEST 17 : Rayon d'influence des lumières ===" << std::endl;
+
+    // A light far from every object, and lights reaching part of the scene
+    const std::string far_light = R"({ "type": "point", "position": { "x": 0, "y": 50, "z": 5 }, "radius": 10,
+                  "diffuse": { "r": 1, "g": 1, "b": 1 }, "specular": { "r": 1, "g": 1, "b": 1 } }, )";
+    const std::string near_lights = R"({ "type": "point", "position": { "x": -1, "y": 0.5, "z": 4 }, "radius": 2,
+                  "diffuse": { "r": 1, "g": 0.5, "b": 0 }, "specular": { "r": 1, "g": 1, "b": 1 } },
+                  { "type": "point", "position": { "x": 1.5, "y": -0.5, "z": 6 }, "radius": 1.5,
+                  "diffuse": { "r": 0, "g": 0.5, "b": 1 }, "specular": { "r": 1, "g": 1, "b": 1 } }, )";
+    std::string scene = twoSpheresScene(-1.5);
+    size_t lights = scene.find("[", scene.find("\"lights\"")) + 2;
+    std::ofstream("test_radius_none.json") << scene;
+    std::ofstream("test_radius_far.json") << scene.substr(0, lights) + far_light + scene.substr(lights);
+    std::ofstream("test_radius_near.json") << scene.substr(0, lights) + near_lights + scene.substr(lights);
+
+    runRaytracer("test_radius_none.json", "test_radius_none.png");
+    runRaytracer("test_radius_far.json", "test_radius_far.png");
+    runRaytracer("test_radius_near.json", "test_radius_recursive.png", true, "--integrator recursive");
+    runRaytracer("test_radius_near.json", "test_radius_wavefront.png", true, "--integrator wavefront");
+
+    std::vector<unsigned char> none_image, far_image, recursive_image, wavefront_image;
+    unsigned none_w, none_h, far_w, far_h, rec_w, rec_h, wave_w, wave_h;
+    ASSERT_TRUE(loadImage("test_radius_none.png", none_image, none_w, none_h));
+    ASSERT_TRUE(loadImage("test_radius_far.png", far_image, far_w, far_h));
+    ASSERT_TRUE(loadImage("test_radius_recursive.png", recursive_image, rec_w, rec_h));
+    ASSERT_TRUE(loadImage("test_radius_wavefront.png", wavefront_image, wave_w, wave_h));
+
+    double rmse_far = calculate_rmse(far_image, far_w, far_h, none_image, none_w, none_h);
+    double rmse = calculate_rmse(recursive_image, rec_w, rec_h, wavefront_image, wave_w, wave_h);
+    double rmse_near = calculate_rmse(recursive_image, rec_w, rec_h, none_image, none_w, none_h);
+    std::cout << " RMSE lumière hors de portée : " << rmse_far << ", entre intégrateurs : " << rmse
+              << ", lumières proches : " << rmse_near << std::endl;
+
+    EXPECT_EQ(rmse_far, 0.0);
+    EXPECT_EQ(rmse, 0.0);
+    EXPECT_GT(rmse_near, 0.0);
+    std::cout << "=== TEST 17 RÉUSSI ===" << std::endl;
+}
+
+// ============================================================================
+// TEST 18 : Caméra look-at
+// Une caméra qui regarde droit devant (+z) donne l'image de la caméra par
+// défaut. Une caméra tournée, avec son champ de vision et son aspect, change
+// l'image, et le rendu incrémental (projection des objets) reste exact
+// ============================================================================
+TEST(RaytracerE2E, LookAtCamera_MatchesDefaultAndIncremental)
+{
+    std::cout << "\n=== TEST 18 : Caméra look-at ===" << std::endl;
+
+    auto withCamera = [](std::string const &scene, std::string const &camera)
+    { return "{\n    \"camera\": " + camera + "," + scene.substr(scene.find('{') + 1); };
+    const std::string ahead = R"({ "position": { "x": 0, "y": 0, "z": 0 }, "lookAt": { "x": 0, "y": 0, "z": 5 } })";
+    const std::string turned = R"({ "position": { "x": 2, "y": 1.5, "z": 1 }, "lookAt": { "x": 0, "y": -0.5, "z": 5.5 },
+                                    "up": { "x": 0, "y": 1, "z": 0 }, "fov": 70, "aspect": 1.5 })";
+
+    std::ofstream("test_lookat_default.json") << twoSpheresScene(-1.5);
+    std::ofstream("test_lookat_ahead.json") << withCamera(twoSpheresScene(-1.5), ahead);
+    std::ofstream("test_lookat_before.json") << withCamera(twoSpheresScene(-1.5), turned);
+    std::ofstream("test_lookat_after.json") << withCamera(twoSpheresScene(-1.2), turned);
+
+    runRaytracer("test_lookat_default.json", "test_lookat_default.png");
+    runRaytracer("test_lookat_ahead.json", "test_lookat_ahead.png");
+    runRaytracer("test_lookat_before.json", "test_lookat_incremental.png");
+    runRaytracer("test_lookat_after.json", "test_lookat_incremental.png", true, "--update-from test_lookat_before.json");
+    runRaytracer("test_lookat_after.json", "test_lookat_full.png", true, "--integrator wavefront");
+
+    std::vector<unsigned char> default_image, ahead_image, incremental_image, full_image;
+    unsigned def_w, def_h, ahead_w, ahead_h, inc_w, inc_h, full_w, full_h;
+    ASSERT_TRUE(loadImage("test_lookat_default.png", default_image, def_w, def_h));
+    ASSERT_TRUE(loadImage("test_lookat_ahead.png", ahead_image, ahead_w, ahead_h));
+    ASSERT_TRUE(loadImage("test_lookat_incremental.png", incremental_image, inc_w, inc_h));
+    ASSERT_TRUE(loadImage("test_lookat_full.png", full_image, full_w, full_h));
+
+    double rmse_ahead = calculate_rmse(ahead_image, ahead_w, ahead_h, default_image, def_w, def_h);
+    double rmse_turned = calculate_rmse(full_image, full_w, full_h, default_image, def_w, def_h);
+    double rmse = calculate_rmse(incremental_image, inc_w, inc_h, full_image, full_w, full_h);
+    std::cout << " RMSE droit devant / par défaut : " << rmse_ahead << ", tournée / par défaut : " << rmse_turned
+              << ", incrémental / complet : " << rmse << std::endl;
+
+    EXPECT_EQ(rmse_ahead, 0.0);
+    EXPECT_GT(rmse_turned, 0.0);
+    EXPECT_EQ(rmse, 0.0);
+    std::cout << "=== TEST 18 RÉUSSI ===" << std::endl;
+}
+
+// ============================================================================
+// TEST 19 : Cache et sous-ensemble de tuiles
+// Un rendu limité à quelques tuiles n'est pas mis en cache : le rendu complet
+// qui suit est le même qu'un rendu complet sans cache
+// ============================================================================
+TEST(RaytracerE2E, RenderCache_TileSubsetIsNotCached)
+{
+    const std::string scene_path = "/app/scenes/two-triangles-on-plane.json";
+    const std::string cache_dir = "test_tiles_cache";
+
+    std::cout << "\n=== TEST 19 : Cache et sous-ensemble de tuiles ===" << std::endl;
+
+    std::filesystem::remove_all(cache_dir);
+    runRaytracer(scene_path, "test_tiles_cache_subset.png", true, "--cache " + cache_dir + " --tiles 0-4");
+    runRaytracer(scene_path, "test_tiles_cache_full.png", true, "--cache " + cache_dir);
+    runRaytracer(scene_path, "test_tiles_uncached.png");
+
+    std::vector<unsigned char> subset_image, full_image, uncached_image;
+    unsigned sub_w, sub_h, full_w, full_h, unc_w, unc_h;
+    ASSERT_TRUE(loadImage("test_tiles_cache_subset.png", subset_image, sub_w, sub_h));
+    ASSERT_TRUE(loadImage("test_tiles_cache_full.png", full_image, full_w, full_h));
+    ASSERT_TRUE(loadImage("test_tiles_uncached.png", uncached_image, unc_w, unc_h));
+
+    double rmse = calculate_rmse(full_image, full_w, full_h, uncached_image, unc_w, unc_h);
+    double rmse_subset = calculate_rmse(subset_image, sub_w, sub_h, uncached_image, unc_w, unc_h);
+    std::cout << " RMSE complet avec cache / sans cache : " << rmse << ", tuiles / complet : " << rmse_subset << std::endl;
+
+    EXPECT_EQ(rmse, 0.0);
+    EXPECT_GT(rmse_subset, 0.0);
+    std::cout << "=== TEST 19 RÉUSSI ===" << std::endl;
+}
+
+// ============================================================================
+// TEST 20 : Anticrénelage adaptatif
+// Les pixels affinés restent centrés sur l'échantillon de base : l'image reste
+// proche du rendu sans anticrénelage, et ne dépend pas du nombre de threads
+// ============================================================================
+TEST(RaytracerE2E, AdaptiveAntialiasing_CloseToBaseAndDeterministic)
+{
+    std::cout << "\n=== TEST 20 : Anticrénelage adaptatif ===" << std::endl;
+
+    std::ofstream("test_aa.json") << twoSpheresScene(-1.5);
+    const std::string aa = "--antialiasing adaptive --aa-max-samples 16 --aa-threshold 0.05";
+    runRaytracer("test_aa.json", "test_aa_base.png");
+    runRaytracer("test_aa.json", "test_aa_1.png", true, aa + " --threads 1");
+    runRaytracer("test_aa.json", "test_aa_2.png", true, aa + " --threads 2");
+
+    std::vector<unsigned char> base_image, one_image, two_image;
+    unsigned base_w, base_h, one_w, one_h, two_w, two_h;
+    ASSERT_TRUE(loadImage("test_aa_base.png", base_image, base_w, base_h));
+    ASSERT_TRUE(loadImage("test_aa_1.png", one_image, one_w, one_h));
+    ASSERT_TRUE(loadImage("test_aa_2.png", two_image, two_w, two_h));
+
+    double rmse_base = calculate_rmse(one_image, one_w, one_h, base_image, base_w, base_h);
+    double rmse_threads = calculate_rmse(one_image, one_w, one_h, two_image, two_w, two_h);
+    std::cout << " RMSE affiné / base : " << rmse_base << ", 1 thread / 2 threads : " << rmse_threads << std::endl;
+
+    EXPECT_GT(rmse_base, 0.0);
+    EXPECT_LT(rmse_base, 5.0);
+    EXPECT_EQ(rmse_threads, 0.0);
+    std::cout << "=== TEST 20 RÉUSSI ===" << std::endl;
+}
+
+// ============================================================================
+// TEST 21 : Grille des lumières
+// Pour chaque point, la grille donne exactement les lumières qui l'atteignent,
+// dans l'ordre de la scène, comme le test de distance de chaque lumière
+// (lumières à cheval sur les cellules, points sur leurs bords, lumières sans
+// rayon intercalées)
+// ============================================================================
+TEST(RaytracerE2E, LightGrid_MatchesPerLightDistanceCheck)
+{
+    std::cout << "\n=== TEST 21 : Grille des lumières ===" << std::endl;
+
+    std::mt19937 random(21);
+    std::uniform_int_distribution<int> coordinate(-8, 8);
+    std::uniform_real_distribution<double> offset(-12, 12);
+    std::vector<Light *> lights;
+    for (int i = 0; i < 300; ++i)
+    {
+        // Integer positions and radii: spheres and points on the cell boundaries
+        Light *light = new Light(Vector3(coordinate(random), coordinate(random), coordinate(random)));
+        light->Radius = i % 10 == 0 ? 0 : 0.5 * (1 + i % 4);
+        lights.push_back(light);
+    }
+    LightGrid grid;
+    grid.build(lights);
+
+    long mismatches = 0;
+    long reached = 0;
+    for (int i = 0; i < 50000; ++i)
+    {
+        Vector3 point = i % 2 ? Vector3(offset(random), offset(random), offset(random))
+                              : Vector3(coordinate(random) * 0.5, coordinate(random) * 0.25, coordinate(random));
+        std::vector<int> expected, found;
+        for (size_t l = 0; l < lights.size(); ++l)
+        {
+            if (lights[l]->Attenuation((lights[l]->GetPosition() - point).lengthSquared()) > 0)
+            {
+                expected.push_back(l);
+            }
+        }
+        grid.forEach(point, [&](int l)
+                     {
+                         if (lights[l]->Attenuation((lights[l]->GetPosition() - point).lengthSquared()) > 0)
+                         {
+                             found.push_back(l);
+                         } });
+        mismatches += found != expected;
+        reached += expected.size();
+    }
+    std::cout << " Points différents : " << mismatches << " sur 50000 (" << reached << " lumières atteintes)" << std::endl;
+
+    EXPECT_EQ(mismatches, 0);
+    for (Light *light : lights)
+    {
+        delete light;
+    }
+    std::cout << "=== TEST 21 RÉUSSI ===" << std::endl;
+}
+
+// ============================================================================
+// TEST 22 : Rendu incrémental en plusieurs processus
+// Avec un maillage, la préparation des deux versions de la scène démarre les
+// threads du pool avant les fork() : chaque processus fils doit pouvoir en
+// créer un autre, et les parties fusionnées sur les seules tuiles touchées
+// donnent l'image d'un rendu complet
+// ============================================================================
+std::string monkeyScene(double x)
+{
+    return R"({
+    "image": { "width": 320, "height": 180 },
+    "reflections": 0,
+    "ambient": { "r": 1, "g": 1, "b": 1 },
+    "lights": [ { "type": "point", "position": { "x": 0, "y": 6, "z": 3 },
+                  "diffuse": { "r": 0.2, "g": 0.2, "b": 0.2 }, "specular": { "r": 0.5, "g": 0.5, "b": 0.5 } } ],
+    "objects": [
+        { "type": "mesh", "obj": "/app/scenes/objects/monkey.obj", "position": { "x": )" + std::to_string(x) + R"(, "y": 0, "z": 5 },
+          "rotation": { "x": 0, "y": 145, "z": 0 },
+          "material": { "type": "phong", "ambient": { "r": 0.5, "g": 0.5, "b": 0.5 }, "reflectivity": 0 } },
+        { "type": "plane", "position": { "x": 0, "y": -1, "z": 0 }, "normal": { "x": 0, "y": 1, "z": 0 },
+          "material": { "type": "phong", "ambient": { "r": 0.2, "g": 0.2, "b": 0.2 }, "diffuse": { "r": 1, "g": 1, "b": 1 },
+                        "specular": { "r": 0, "g": 0, "b": 0 }, "shininess": 1 } }
+    ]
+})";
+}
+
+TEST(RaytracerE2E, IncrementalRender_WithProcesses)
+{
+    const std::string before_path = "test_incremental_mesh_before.json";
+    const std::string after_path = "test_incremental_mesh_after.json";
+    const std::string incremental_path = "test_incremental_mesh.png";
+    const std::string full_path = "test_incremental_mesh_full.png";
+
+    std::cout << "\n=== TEST 22 : Rendu incrémental en plusieurs processus ===" << std::endl;
+
+    std::ofstream(before_path) << monkeyScene(-1);
+    std::ofstream(after_path) << monkeyScene(-0.8);
+
+    runRaytracer(before_path, incremental_path);
+    // Pool of 4 threads while preparing, of 2 in each process
+    runRaytracer(after_path, incremental_path, true, "--update-from " + before_path + " --processes 2 --threads 4");
+    runRaytracer(after_path, full_path);
+
+    std::vector<unsigned char> incremental_image, full_image;
+    unsigned inc_w, inc_h, full_w, full_h;
+    ASSERT_TRUE(loadImage(incremental_path, incremental_image, inc_w, inc_h));
+    ASSERT_TRUE(loadImage(full_path, full_image, full_w, full_h));
+
+    double rmse = calculate_rmse(incremental_image, inc_w, inc_h, full_image, full_w, full_h);
+    std::cout << " RMSE : " << rmse << std::endl;
+
+    EXPECT_EQ(rmse, 0.0);
+    std::cout << "=== TEST 22 RÉUSSI ===" << std::endl;
+}
+
+// ============================================================================
+// TEST 23 : Démon et clients simultanés
+// Un client resté connecté, arrêté au milieu d'une requête, ne bloque pas les
+// autres : un deuxième client a sa réponse avant que le premier ne termine
+// ============================================================================
+TEST(RaytracerE2E, Daemon_AnswersWhileAnotherClientIsConnected)
+{
+    const std::string socket_path = "/tmp/raytracer_test_clients.sock";
+
+    std::cout << "\n=== TEST 23 : Démon et clients simultanés ===" << std::endl;
+
+    std::string executable_path = TOSTRING(RAYTRACER_EXECUTABLE);
+    std::system((executable_path + " --daemon " + socket_path + " > /dev/null &").c_str());
+
+    int first = connectDaemon(socket_path);
+    ASSERT_GE(first, 0) << "Le démon n'a pas ouvert " << socket_path;
+    const std::string halfRequest = "{\"command\": ";
+    EXPECT_EQ(write(first, halfRequest.data(), halfRequest.size()), (ssize_t)halfRequest.size());
+
+    // Not answered at all by a daemon serving one connection at a time: no hang
+    int second = connectDaemon(socket_path);
+    ASSERT_GE(second, 0);
+    timeval timeout = {10, 0};
+    setsockopt(second, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    std::string answer = daemonRequest(second, "{\"command\": \"stats\"}");
+    close(second);
+
+    // The first request ends, then stops the daemon
+    std::string stats = daemonRequest(first, "\"stats\"}");
+    daemonRequest(first, "{\"command\": \"shutdown\"}");
+    close(first);
+
+    EXPECT_NE(answer.find("\"ok\":true"), std::string::npos);
+    EXPECT_NE(stats.find("\"ok\":true"), std::string::npos);
+    std::cout << "=== TEST 23 RÉUSSI ===" << std::endl;
+}